@@ -1,12 +1,30 @@
 #include "board.h"
+#include "eval.h"
 #include "log.h"
 
+#include <ctype.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 static int _cortex_board_gen_basic_moves(cortex_board* b, cortex_move_list* out);
-static int _cortex_board_gen_basic_moves_for(cortex_board* b, cortex_square sq, cortex_move_list* out);
+static inline int _cortex_board_gen_basic_moves_for(cortex_board* b, cortex_square sq, cortex_move_list* out, cortex_piece_color from_color) __attribute__((always_inline));
+static int _cortex_board_gen_basic_moves_white(cortex_board* b, cortex_move_list* out);
+static int _cortex_board_gen_basic_moves_black(cortex_board* b, cortex_move_list* out);
+static void _cortex_board_init_zobrist();
+static uint64_t _cortex_board_zobrist_piece(cortex_square sq, cortex_piece p);
+static void _cortex_board_score_piece(cortex_board* b, cortex_square sq, cortex_piece p, int sign);
+static uint64_t _cortex_board_step(int rank, int file);
+static uint64_t _cortex_board_steps(int rank, int file, const int steps[8][2]);
+static uint64_t _cortex_board_rays(cortex_board* b, int rank, int file, int straight, int diagonal);
+static uint64_t _cortex_board_color_attacks(cortex_board* b, cortex_piece_color col);
+static int _cortex_board_aligned(cortex_square a, cortex_square b);
+
+/* Zobrist keys, indexed by square and piece (type, plus 8 for white). */
+static uint64_t _cortex_board_zobrist[64][16];
+static uint64_t _cortex_board_zobrist_side;
+static uint64_t _cortex_board_zobrist_ep[8];
+static int _cortex_board_zobrist_ready;
 
 cortex_piece CORTEX_BOARD_INITIAL_STATE[] = {
     CORTEX_PIECE_WHITE_ROOK, CORTEX_PIECE_WHITE_KNIGHT, CORTEX_PIECE_WHITE_BISHOP, CORTEX_PIECE_WHITE_QUEEN, CORTEX_PIECE_WHITE_KING, CORTEX_PIECE_WHITE_BISHOP, CORTEX_PIECE_WHITE_KNIGHT, CORTEX_PIECE_WHITE_ROOK,
@@ -28,6 +46,7 @@ int cortex_board_init(cortex_board* dst) {
 
     cortex_log_debug("Initializing move history");
     cortex_move_list_init(&dst->move_history);
+    cortex_board_update_key(dst);
 
     cortex_log_debug("Generating legal moves");
     cortex_board_gen_legal_moves(dst);
@@ -37,6 +56,139 @@ int cortex_board_init(cortex_board* dst) {
     return 0;
 }
 
+int cortex_board_set_fen(cortex_board* dst, const char* fen) {
+    if (!dst || !fen) return -1;
+
+    memset(dst->state, 0, sizeof dst->state);
+    cortex_move_list_init(&dst->move_history);
+
+    /* Placement, from the eighth rank down and the a file across. */
+    int rank = 8, file = 1;
+
+    for (; *fen && *fen != ' '; ++fen) {
+        if (*fen == '/') {
+            if (file != 9 || --rank < 1) return -1;
+            file = 1;
+        } else if (*fen >= '1' && *fen <= '8') {
+            file += *fen - '0';
+            if (file > 9) return -1;
+        } else {
+            const char* types = strchr("pkqrbn", tolower(*fen));
+            if (!types || !*types || file > 8) return -1;
+
+            cortex_piece p = CORTEX_PIECE_TYPE_PAWN + (types - "pkqrbn");
+            if (isupper(*fen)) p = CORTEX_PIECE_TO_WHITE(p);
+
+            dst->state[CORTEX_SQUARE_AT(rank, file++)] = p;
+        }
+    }
+
+    if (rank != 1 || file != 9) return -1;
+
+    while (*fen == ' ') ++fen;
+
+    if (*fen == 'w') {
+        dst->color_to_move = CORTEX_PIECE_COLOR_WHITE;
+    } else if (*fen == 'b') {
+        dst->color_to_move = CORTEX_PIECE_COLOR_BLACK;
+    } else {
+        return -1;
+    }
+
+    ++fen;
+    while (*fen == ' ') ++fen;
+
+    /* Castling rights. */
+    while (*fen && *fen != ' ') ++fen;
+    while (*fen == ' ') ++fen;
+
+    /* An en passant square becomes the pawn double move that allowed it, which is how the move generator finds it. */
+    if (*fen >= 'a' && *fen <= 'h' && (fen[1] == '3' || fen[1] == '6')) {
+        int ep_file = *fen - 'a' + 1, ep_rank = fen[1] - '0';
+        int dir = (ep_rank == 3) ? 1 : -1;
+
+        cortex_move last = { 0 };
+        last.move_type = CORTEX_MOVE_TYPE_MOVE;
+        last.from = CORTEX_SQUARE_AT(ep_rank - dir, ep_file);
+        last.to = CORTEX_SQUARE_AT(ep_rank + dir, ep_file);
+        last.complete = 1;
+        last.is_pawn_double = 1;
+
+        cortex_move_list_add(&dst->move_history, last);
+        fen += 2;
+    } else if (*fen == '-') {
+        ++fen;
+    } else {
+        return -1;
+    }
+
+    while (*fen == ' ') ++fen;
+    int halfmove_clock = isdigit(*fen) ? atoi(fen) : 0;
+
+    /* The key history starts from the whole position, en passant square included. */
+    cortex_board_update_key(dst);
+    dst->halfmove_clock = halfmove_clock;
+
+    return cortex_board_gen_legal_moves(dst);
+}
+
+int cortex_board_update_key(cortex_board* dst) {
+    if (!dst) return -1;
+
+    _cortex_board_init_zobrist();
+
+    dst->key = 0;
+
+    for (int sq = 0; sq < 64; ++sq) {
+        dst->key ^= _cortex_board_zobrist_piece(sq, dst->state[sq]);
+    }
+
+    cortex_board_update_scores(dst);
+
+    if (dst->color_to_move == CORTEX_PIECE_COLOR_WHITE) dst->key ^= _cortex_board_zobrist_side;
+
+    if (dst->move_history.len) {
+        cortex_move last = dst->move_history.list[dst->move_history.len - 1];
+        if (last.is_pawn_double) dst->key ^= _cortex_board_zobrist_ep[CORTEX_SQUARE_FILE(last.to) - 1];
+    }
+
+    /* Earlier positions are unknown, so repetitions start from here. A key of 0 never matches one. */
+    dst->halfmove_clock = 0;
+
+    memset(dst->key_history, 0, sizeof dst->key_history);
+    dst->key_history[dst->move_history.len % CORTEX_BOARD_KEY_HISTORY] = dst->key;
+
+    return 0;
+}
+
+int cortex_board_update_scores(cortex_board* dst) {
+    if (!dst) return -1;
+
+    dst->material = dst->phase = dst->psq = 0;
+    cortex_eval_nnue_refresh(&dst->nnue);
+
+    for (int sq = 0; sq < 64; ++sq) {
+        _cortex_board_score_piece(dst, sq, dst->state[sq], 1);
+    }
+
+    return 0;
+}
+
+int cortex_board_is_draw(cortex_board* dst, int repetitions) {
+    if (!dst) return -1;
+
+    if (dst->halfmove_clock >= 100) return 1;
+
+    /* The same color is to move every other ply, and returning to a position takes at least four. */
+    int found = 0, len = dst->move_history.len;
+
+    for (int i = len - 4; i >= len - dst->halfmove_clock && i >= 0; i -= 2) {
+        if (dst->key_history[i % CORTEX_BOARD_KEY_HISTORY] == dst->key && ++found >= repetitions) return 1;
+    }
+
+    return 0;
+}
+
 void cortex_board_draw_types(cortex_board* dst) {
     for (int rank = 8; rank >= 1; --rank) {
         for (int file = 1; file <= 8; ++file) {
@@ -47,135 +199,96 @@ void cortex_board_draw_types(cortex_board* dst) {
     }
 }
 
-int cortex_board_add_attacked_squares(cortex_board* dst, cortex_square sq, cortex_square_list* out) {
-    /* get attacked squares from a certain piece */
-    if (!dst) return -1;
+uint64_t cortex_board_get_attacks(cortex_board* dst, cortex_square sq) {
+    static const int knight_steps[8][2] = { { 2, 1 }, { 2, -1 }, { -2, 1 }, { -2, -1 }, { 1, 2 }, { -1, 2 }, { 1, -2 }, { -1, -2 } };
+    static const int king_steps[8][2] = { { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, -1 }, { 0, 1 }, { -1, -1 }, { -1, 0 }, { -1, 1 } };
 
     cortex_piece from_piece = dst->state[sq];
-    cortex_piece_type from_type = CORTEX_PIECE_GET_TYPE(from_piece);
-    cortex_piece_color from_color = CORTEX_PIECE_GET_COLOR(from_piece);
-
     int from_rank = CORTEX_SQUARE_RANK(sq);
     int from_file = CORTEX_SQUARE_FILE(sq);
 
-    int pawn_rank_offset = (from_color == CORTEX_PIECE_COLOR_WHITE) ? 1 : -1;
+    int pawn_rank_offset = (CORTEX_PIECE_GET_COLOR(from_piece) == CORTEX_PIECE_COLOR_WHITE) ? 1 : -1;
 
-    switch (from_type) {
-    case CORTEX_PIECE_TYPE_NONE:
-        return 0;
+    switch (CORTEX_PIECE_GET_TYPE(from_piece)) {
     case CORTEX_PIECE_TYPE_PAWN:
-        cortex_square_list_add(out, cortex_square_offset(sq, pawn_rank_offset, 1));
-        cortex_square_list_add(out, cortex_square_offset(sq, pawn_rank_offset, -1));
-        return 0;
+        return _cortex_board_step(from_rank + pawn_rank_offset, from_file + 1) | _cortex_board_step(from_rank + pawn_rank_offset, from_file - 1);
     case CORTEX_PIECE_TYPE_KING:
-        cortex_square_list_add(out, cortex_square_offset(sq, 1, -1));
-        cortex_square_list_add(out, cortex_square_offset(sq, 1, 0));
-        cortex_square_list_add(out, cortex_square_offset(sq, 1, 1));
-        cortex_square_list_add(out, cortex_square_offset(sq, 0, -1));
-        cortex_square_list_add(out, cortex_square_offset(sq, 0, 1));
-        cortex_square_list_add(out, cortex_square_offset(sq, -1, -1));
-        cortex_square_list_add(out, cortex_square_offset(sq, -1, 0));
-        cortex_square_list_add(out, cortex_square_offset(sq, -1, 1));
-        return 0;
+        return _cortex_board_steps(from_rank, from_file, king_steps);
+    case CORTEX_PIECE_TYPE_KNIGHT:
+        return _cortex_board_steps(from_rank, from_file, knight_steps);
     case CORTEX_PIECE_TYPE_QUEEN:
-        for (int x = from_file + 1; x <= 8; ++x) {
-            cortex_square_list_add(out, CORTEX_SQUARE_AT(from_rank, x));
-            if (dst->state[CORTEX_SQUARE_AT(from_rank, x)]) break;
-        }
-        for (int x = from_file - 1; x >= 1; --x) {
-            cortex_square_list_add(out, CORTEX_SQUARE_AT(from_rank, x));
-            if (dst->state[CORTEX_SQUARE_AT(from_rank, x)]) break;
-        }
-        for (int y = from_rank + 1; y <= 8; ++y) {
-            cortex_square_list_add(out, CORTEX_SQUARE_AT(y, from_file));
-            if (dst->state[CORTEX_SQUARE_AT(y, from_file)]) break;
-        }
-        for (int y = from_rank - 1; y >= 1; --y) {
-            cortex_square_list_add(out, CORTEX_SQUARE_AT(y, from_file));
-            if (dst->state[CORTEX_SQUARE_AT(y, from_file)]) break;
-        }
-        for (int i = 1; i <= 8; ++i) {
-            cortex_square dsq = cortex_square_offset(sq, i, i);
-            if (!CORTEX_SQUARE_VALID(dsq)) break;
-            cortex_square_list_add(out, dsq);
-            if (dst->state[dsq]) break;
-        }
-        for (int i = 1; i <= 8; ++i) {
-            cortex_square dsq = cortex_square_offset(sq, i, -i);
-            if (!CORTEX_SQUARE_VALID(dsq)) break;
-            cortex_square_list_add(out, dsq);
-            if (dst->state[dsq]) break;
-        }
-        for (int i = 1; i <= 8; ++i) {
-            cortex_square dsq = cortex_square_offset(sq, -i, i);
-            if (!CORTEX_SQUARE_VALID(dsq)) break;
-            cortex_square_list_add(out, dsq);
-            if (dst->state[dsq]) break;
-        }
-        for (int i = 1; i <= 8; ++i) {
-            cortex_square dsq = cortex_square_offset(sq, -i, -i);
-            if (!CORTEX_SQUARE_VALID(dsq)) break;
-            cortex_square_list_add(out, dsq);
-            if (dst->state[dsq]) break;
-        }
-        return 0;
+        return _cortex_board_rays(dst, from_rank, from_file, 1, 1);
     case CORTEX_PIECE_TYPE_ROOK:
-        for (int x = from_file + 1; x <= 8; ++x) {
-            cortex_square_list_add(out, CORTEX_SQUARE_AT(from_rank, x));
-            if (dst->state[CORTEX_SQUARE_AT(from_rank, x)]) break;
-        }
-        for (int x = from_file - 1; x >= 1; --x) {
-            cortex_square_list_add(out, CORTEX_SQUARE_AT(from_rank, x));
-            if (dst->state[CORTEX_SQUARE_AT(from_rank, x)]) break;
-        }
-        for (int y = from_rank + 1; y <= 8; ++y) {
-            cortex_square_list_add(out, CORTEX_SQUARE_AT(y, from_file));
-            if (dst->state[CORTEX_SQUARE_AT(y, from_file)]) break;
-        }
-        for (int y = from_rank - 1; y >= 1; --y) {
-            cortex_square_list_add(out, CORTEX_SQUARE_AT(y, from_file));
-            if (dst->state[CORTEX_SQUARE_AT(y, from_file)]) break;
-        }
-        return 0;
+        return _cortex_board_rays(dst, from_rank, from_file, 1, 0);
     case CORTEX_PIECE_TYPE_BISHOP:
-        for (int i = 1; i <= 8; ++i) {
-            cortex_square dsq = cortex_square_offset(sq, i, i);
-            if (!CORTEX_SQUARE_VALID(dsq)) break;
-            cortex_square_list_add(out, dsq);
-            if (dst->state[dsq]) break;
-        }
-        for (int i = 1; i <= 8; ++i) {
-            cortex_square dsq = cortex_square_offset(sq, i, -i);
-            if (!CORTEX_SQUARE_VALID(dsq)) break;
-            cortex_square_list_add(out, dsq);
-            if (dst->state[dsq]) break;
-        }
-        for (int i = 1; i <= 8; ++i) {
-            cortex_square dsq = cortex_square_offset(sq, -i, i);
-            if (!CORTEX_SQUARE_VALID(dsq)) break;
-            cortex_square_list_add(out, dsq);
-            if (dst->state[dsq]) break;
-        }
-        for (int i = 1; i <= 8; ++i) {
-            cortex_square dsq = cortex_square_offset(sq, -i, -i);
-            if (!CORTEX_SQUARE_VALID(dsq)) break;
-            cortex_square_list_add(out, dsq);
-            if (dst->state[dsq]) break;
+        return _cortex_board_rays(dst, from_rank, from_file, 0, 1);
+    }
+
+    return 0;
+}
+
+uint64_t cortex_board_get_attackers(cortex_board* dst, cortex_square sq, uint64_t removed) {
+    static const int knight_steps[8][2] = { { 2, 1 }, { 2, -1 }, { -2, 1 }, { -2, -1 }, { 1, 2 }, { -1, 2 }, { 1, -2 }, { -1, -2 } };
+    static const int king_steps[8][2] = { { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, -1 }, { 0, 1 }, { -1, -1 }, { -1, 0 }, { -1, 1 } };
+    static const int directions[8][2] = { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+    int rank = CORTEX_SQUARE_RANK(sq);
+    int file = CORTEX_SQUARE_FILE(sq);
+    uint64_t set = 0;
+
+    /* Leapers can be read straight off their own step patterns from the target square. */
+    for (uint64_t from = _cortex_board_steps(rank, file, knight_steps) & ~removed; from; from &= from - 1) {
+        cortex_square s = __builtin_ctzll(from);
+        if (CORTEX_PIECE_GET_TYPE(dst->state[s]) == CORTEX_PIECE_TYPE_KNIGHT) set |= CORTEX_BOARD_SQUARE_BIT(s);
+    }
+
+    for (uint64_t from = _cortex_board_steps(rank, file, king_steps) & ~removed; from; from &= from - 1) {
+        cortex_square s = __builtin_ctzll(from);
+        if (CORTEX_PIECE_GET_TYPE(dst->state[s]) == CORTEX_PIECE_TYPE_KING) set |= CORTEX_BOARD_SQUARE_BIT(s);
+    }
+
+    /* A white pawn attacks from the rank below, a black pawn from the rank above. */
+    for (uint64_t from = (_cortex_board_step(rank - 1, file - 1) | _cortex_board_step(rank - 1, file + 1)) & ~removed; from; from &= from - 1) {
+        cortex_square s = __builtin_ctzll(from);
+        if (dst->state[s] == CORTEX_PIECE_WHITE_PAWN) set |= CORTEX_BOARD_SQUARE_BIT(s);
+    }
+
+    for (uint64_t from = (_cortex_board_step(rank + 1, file - 1) | _cortex_board_step(rank + 1, file + 1)) & ~removed; from; from &= from - 1) {
+        cortex_square s = __builtin_ctzll(from);
+        if (dst->state[s] == CORTEX_PIECE_BLACK_PAWN) set |= CORTEX_BOARD_SQUARE_BIT(s);
+    }
+
+    /* Sliders: the first piece along each line attacks if it moves along that kind of line. */
+    for (int d = 0; d < 8; ++d) {
+        int r = rank + directions[d][0], f = file + directions[d][1];
+
+        for (; r >= 1 && r <= 8 && f >= 1 && f <= 8; r += directions[d][0], f += directions[d][1]) {
+            cortex_square s = CORTEX_SQUARE_AT(r, f);
+            if (!dst->state[s] || (removed & CORTEX_BOARD_SQUARE_BIT(s))) continue;
+
+            cortex_piece_type type = CORTEX_PIECE_GET_TYPE(dst->state[s]);
+
+            if (type == CORTEX_PIECE_TYPE_QUEEN || type == (d < 4 ? CORTEX_PIECE_TYPE_ROOK : CORTEX_PIECE_TYPE_BISHOP)) {
+                set |= CORTEX_BOARD_SQUARE_BIT(s);
+            }
+
+            break;
         }
-        return 0;
-    case CORTEX_PIECE_TYPE_KNIGHT:
-        cortex_square_list_add(out, cortex_square_offset(sq, 2, 1));
-        cortex_square_list_add(out, cortex_square_offset(sq, 2, -1));
-        cortex_square_list_add(out, cortex_square_offset(sq, -2, 1));
-        cortex_square_list_add(out, cortex_square_offset(sq, -2, -1));
-        cortex_square_list_add(out, cortex_square_offset(sq, 1, 2));
-        cortex_square_list_add(out, cortex_square_offset(sq, -1, 2));
-        cortex_square_list_add(out, cortex_square_offset(sq, 1, -2));
-        cortex_square_list_add(out, cortex_square_offset(sq, -1, -2));
-        return 0;
     }
 
-    return -1;
+    return set;
+}
+
+int cortex_board_add_attacked_squares(cortex_board* dst, cortex_square sq, cortex_square_list* out) {
+    /* get attacked squares from a certain piece */
+    if (!dst) return -1;
+    if (!CORTEX_PIECE_IS_VALID(dst->state[sq])) return -1;
+
+    for (uint64_t set = cortex_board_get_attacks(dst, sq); set; set &= set - 1) {
+        cortex_square_list_add(out, __builtin_ctzll(set));
+    }
+
+    return 0;
 }
 
 int cortex_board_add_attacked_squares_color(cortex_board* dst, cortex_piece_color col, cortex_square_list* out) {
@@ -191,26 +304,33 @@ int cortex_board_add_attacked_squares_color(cortex_board* dst, cortex_piece_colo
     return 0;
 }
 
-int cortex_board_get_color_in_check(cortex_board* dst, cortex_piece_color col) {
+int cortex_board_update_attacks(cortex_board* dst) {
     if (!dst) return -1;
 
-    /* find the matching king */
-    for (int i = 0; i < 64; ++i) {
-        cortex_piece p = dst->state[i];
+    dst->attacks[0] = dst->attacks[1] = 0;
+    dst->king[0] = dst->king[1] = CORTEX_SQUARE_INVALID;
 
-        cortex_piece_type t = CORTEX_PIECE_GET_TYPE(p);
-        cortex_piece_color c = CORTEX_PIECE_GET_COLOR(p);
+    for (int s = 0; s < 64; ++s) {
+        cortex_piece p = dst->state[s];
+        if (!CORTEX_PIECE_GET_TYPE(p)) continue;
 
-        if (t == CORTEX_PIECE_TYPE_KING && c == col) {
-            /* Square located, now invert the color and see if the square is attacked */
-            col = !col;
+        dst->attacks[CORTEX_PIECE_GET_COLOR(p)] |= cortex_board_get_attacks(dst, s);
+        if (CORTEX_PIECE_GET_TYPE(p) == CORTEX_PIECE_TYPE_KING) dst->king[CORTEX_PIECE_GET_COLOR(p)] = s;
+    }
 
-            cortex_square_list sqlist;
-            cortex_square_list_init(&sqlist);
+    return 0;
+}
 
-            cortex_board_add_attacked_squares_color(dst, col, &sqlist);
+int cortex_board_get_color_in_check(cortex_board* dst, cortex_piece_color col) {
+    if (!dst) return -1;
 
-            return cortex_square_list_contains(&sqlist, i);
+    /* find the matching king */
+    for (int i = 0; i < 64; ++i) {
+        cortex_piece p = dst->state[i];
+
+        if (CORTEX_PIECE_GET_TYPE(p) == CORTEX_PIECE_TYPE_KING && CORTEX_PIECE_GET_COLOR(p) == col) {
+            /* Square located, now see if the other color attacks it */
+            return (_cortex_board_color_attacks(dst, !col) & CORTEX_BOARD_SQUARE_BIT(i)) != 0;
         }
     }
 
@@ -222,6 +342,9 @@ int cortex_board_gen_legal_moves(cortex_board* dst) {
 
     cortex_move_list_init(&dst->legal_moves);
 
+    /* Legality and check tests of every move share the attacks of this position. */
+    cortex_board_update_attacks(dst);
+
     /* Clear the move list, we will generate it from scratch. */
     cortex_move_list basic_moves;
     cortex_move_list_init(&basic_moves);
@@ -246,21 +369,30 @@ int _cortex_board_gen_basic_moves(cortex_board* b, cortex_move_list* out) {
     if (!b || !out) return -1;
 
     /* Basic moves include moves, captures, and promotions. */
-    for (int sq = 0; sq < 64; ++sq) {
-        if (CORTEX_PIECE_GET_COLOR(b->state[sq]) == b->color_to_move) {
-            if (_cortex_board_gen_basic_moves_for(b, sq, out)) return -1;
-        }
-    }
-
-    return 0;
+    if (b->color_to_move == CORTEX_PIECE_COLOR_WHITE) return _cortex_board_gen_basic_moves_white(b, out);
+    return _cortex_board_gen_basic_moves_black(b, out);
 }
 
-int _cortex_board_gen_basic_moves_for(cortex_board* b, cortex_square sq, cortex_move_list* out) {
-    if (!b || !out) return -1;
+/*
+ * The generator is instantiated once per color, so the pawn direction and ranks and the color tests
+ * are all constants. The color to move is only looked at once per position.
+ */
+#define CORTEX_BOARD_GEN_BASIC_MOVES(suffix, color) \
+    static int _cortex_board_gen_basic_moves_##suffix(cortex_board* b, cortex_move_list* out) { \
+        for (int sq = 0; sq < 64; ++sq) { \
+            if (!CORTEX_PIECE_GET_TYPE(b->state[sq]) || CORTEX_PIECE_GET_COLOR(b->state[sq]) != (color)) continue; \
+            if (_cortex_board_gen_basic_moves_for(b, sq, out, (color))) return -1; \
+        } \
+        return 0; \
+    }
+
+CORTEX_BOARD_GEN_BASIC_MOVES(white, CORTEX_PIECE_COLOR_WHITE)
+CORTEX_BOARD_GEN_BASIC_MOVES(black, CORTEX_PIECE_COLOR_BLACK)
 
+/* Generate the moves of the piece on <sq>, which has the color <from_color>. */
+static inline int _cortex_board_gen_basic_moves_for(cortex_board* b, cortex_square sq, cortex_move_list* out, cortex_piece_color from_color) {
     cortex_piece from_piece = b->state[sq];
     cortex_piece_type from_type = CORTEX_PIECE_GET_TYPE(from_piece);
-    cortex_piece_color from_color = CORTEX_PIECE_GET_COLOR(from_piece);
 
     int from_rank = CORTEX_SQUARE_RANK(sq);
     int from_file = CORTEX_SQUARE_FILE(sq);
@@ -771,6 +903,26 @@ int cortex_board_complete_move(cortex_board* dst, cortex_move* move, cortex_boar
     /* Copy over board state */
     memcpy(&result, dst, sizeof result);
 
+    /* Take the moved and captured pieces out of the key before the state changes. */
+    uint64_t key = result.key ^ _cortex_board_zobrist_side;
+    int irreversible = (move->move_type == CORTEX_MOVE_TYPE_CAPTURE) || CORTEX_PIECE_GET_TYPE(result.state[move->from]) == CORTEX_PIECE_TYPE_PAWN;
+
+    key ^= _cortex_board_zobrist_piece(move->from, result.state[move->from]);
+    key ^= _cortex_board_zobrist_piece(move->to, result.state[move->to]);
+
+    cortex_square en_passant = CORTEX_SQUARE_INVALID;
+
+    if (result.move_history.len) {
+        cortex_move last = result.move_history.list[result.move_history.len - 1];
+
+        if (last.is_pawn_double) key ^= _cortex_board_zobrist_ep[CORTEX_SQUARE_FILE(last.to) - 1];
+
+        if (move->is_en_passant) {
+            en_passant = last.to;
+            key ^= _cortex_board_zobrist_piece(en_passant, result.state[en_passant]);
+        }
+    }
+
     /* Modify resulting state */
     result.state[move->to] = result.state[move->from];
     result.state[move->from] = 0;
@@ -786,19 +938,68 @@ int cortex_board_complete_move(cortex_board* dst, cortex_move* move, cortex_boar
 
     /* If move is en-passant, find and remove the pawn captured */
     if (move->is_en_passant) {
-        result.state[result.move_history.list[result.move_history.len - 1].to] = 0;
+        result.state[en_passant] = 0;
+    }
+
+    /*
+     * If the color that just moved is in check, the move is illegal. Unless the king was already in check,
+     * only a king move, en passant, or a piece leaving a line to its own king can change that.
+     */
+    cortex_piece_color mover = result.color_to_move;
+    cortex_square own_king = dst->king[mover];
+
+    int safe = own_king != CORTEX_SQUARE_INVALID && !(dst->attacks[!mover] & CORTEX_BOARD_SQUARE_BIT(own_king)) && !move->is_en_passant;
+
+    if (safe && move->from == own_king) {
+        safe = !(dst->attacks[!mover] & CORTEX_BOARD_SQUARE_BIT(move->to));
+    } else if (safe) {
+        safe = !_cortex_board_aligned(move->from, own_king);
     }
 
-    /* If the color that just moved is in check, the move is illegal. */
-    if (cortex_board_get_color_in_check(&result, result.color_to_move)) {
+    if (!safe && cortex_board_get_color_in_check(&result, mover)) {
         return -1;
     }
 
     cortex_move_list_add(&result.move_history, *move);
     result.color_to_move = !result.color_to_move;
 
-    /* If the other color is in check, add a check attr. */
-    if (cortex_board_get_color_in_check(&result, result.color_to_move)) {
+    key ^= _cortex_board_zobrist_piece(move->to, result.state[move->to]);
+
+    /*
+     * The evaluation terms and the network's accumulator are only needed by a move that is played,
+     * not by the legality and check tests of every generated move.
+     */
+    if (out) {
+        _cortex_board_score_piece(&result, move->from, dst->state[move->from], -1);
+        _cortex_board_score_piece(&result, move->to, dst->state[move->to], -1);
+        _cortex_board_score_piece(&result, en_passant, (en_passant == CORTEX_SQUARE_INVALID) ? 0 : dst->state[en_passant], -1);
+        _cortex_board_score_piece(&result, move->to, result.state[move->to], 1);
+    }
+
+    if (move->is_pawn_double) key ^= _cortex_board_zobrist_ep[CORTEX_SQUARE_FILE(move->to) - 1];
+
+    result.key = key;
+    result.key_history[result.move_history.len % CORTEX_BOARD_KEY_HISTORY] = key;
+    result.halfmove_clock = irreversible ? 0 : result.halfmove_clock + 1;
+
+    /*
+     * If the other color is in check, add a check attr. Either the moved piece gives it, or a piece of
+     * the mover's behind a square the move emptied does, which only a full scan can tell.
+     */
+    cortex_square other_king = dst->king[!mover];
+    int check;
+
+    if (other_king == CORTEX_SQUARE_INVALID || move->is_en_passant) {
+        check = cortex_board_get_color_in_check(&result, result.color_to_move) == 1;
+    } else {
+        check = (cortex_board_get_attacks(&result, move->to) & CORTEX_BOARD_SQUARE_BIT(other_king)) != 0;
+
+        if (!check && _cortex_board_aligned(move->from, other_king)) {
+            check = (_cortex_board_color_attacks(&result, mover) & CORTEX_BOARD_SQUARE_BIT(other_king)) != 0;
+        }
+    }
+
+    if (check) {
         cortex_board_gen_legal_moves(&result);
 
         if (!result.legal_moves.len) {
@@ -834,3 +1035,97 @@ int cortex_board_apply_move(cortex_board* dst, cortex_move move) {
 
     return 0;
 }
+
+static void _cortex_board_init_zobrist() {
+    if (_cortex_board_zobrist_ready) return;
+
+    /* xorshift64*, seeded so keys are the same on every run. */
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+
+    for (int i = 0; i < 64 * 16 + 1 + 8; ++i) {
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+
+        uint64_t k = x * 0x2545F4914F6CDD1DULL;
+
+        if (i < 64 * 16) {
+            _cortex_board_zobrist[i / 16][i % 16] = k;
+        } else if (i == 64 * 16) {
+            _cortex_board_zobrist_side = k;
+        } else {
+            _cortex_board_zobrist_ep[i - 64 * 16 - 1] = k;
+        }
+    }
+
+    _cortex_board_zobrist_ready = 1;
+}
+
+static uint64_t _cortex_board_zobrist_piece(cortex_square sq, cortex_piece p) {
+    if (!p) return 0;
+    return _cortex_board_zobrist[sq][CORTEX_PIECE_GET_TYPE(p) | (CORTEX_PIECE_GET_COLOR(p) << 3)];
+}
+
+/* Add (<sign> 1) or remove (-1) a piece's share of the evaluation terms. */
+static void _cortex_board_score_piece(cortex_board* b, cortex_square sq, cortex_piece p, int sign) {
+    if (!p) return;
+
+    int32_t value = cortex_eval_piece_value(p);
+
+    b->material += (CORTEX_PIECE_GET_COLOR(p) == CORTEX_PIECE_COLOR_WHITE) ? sign * value : -sign * value;
+    b->phase += sign * cortex_eval_piece_phase(p);
+    b->psq += sign * cortex_eval_piece_square(p, sq);
+
+    cortex_eval_nnue_update(&b->nnue, sq, p, sign);
+}
+
+static uint64_t _cortex_board_step(int rank, int file) {
+    if (rank < 1 || rank > 8 || file < 1 || file > 8) return 0;
+    return CORTEX_BOARD_SQUARE_BIT(CORTEX_SQUARE_AT(rank, file));
+}
+
+static uint64_t _cortex_board_steps(int rank, int file, const int steps[8][2]) {
+    uint64_t set = 0;
+
+    for (int i = 0; i < 8; ++i) {
+        set |= _cortex_board_step(rank + steps[i][0], file + steps[i][1]);
+    }
+
+    return set;
+}
+
+/* Squares a slider reaches along straight and/or diagonal lines, up to and including the first piece on each. */
+static uint64_t _cortex_board_rays(cortex_board* b, int rank, int file, int straight, int diagonal) {
+    static const int directions[8][2] = { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+    uint64_t set = 0;
+
+    for (int d = straight ? 0 : 4; d < (diagonal ? 8 : 4); ++d) {
+        int r = rank + directions[d][0], f = file + directions[d][1];
+
+        for (; r >= 1 && r <= 8 && f >= 1 && f <= 8; r += directions[d][0], f += directions[d][1]) {
+            set |= CORTEX_BOARD_SQUARE_BIT(CORTEX_SQUARE_AT(r, f));
+            if (b->state[CORTEX_SQUARE_AT(r, f)]) break;
+        }
+    }
+
+    return set;
+}
+
+static uint64_t _cortex_board_color_attacks(cortex_board* b, cortex_piece_color col) {
+    uint64_t set = 0;
+
+    for (int s = 0; s < 64; ++s) {
+        if (!CORTEX_PIECE_GET_TYPE(b->state[s]) || CORTEX_PIECE_GET_COLOR(b->state[s]) != col) continue;
+        set |= cortex_board_get_attacks(b, s);
+    }
+
+    return set;
+}
+
+/* Check if two squares share a rank, file or diagonal, so a slider could see one through the other. */
+static int _cortex_board_aligned(cortex_square a, cortex_square b) {
+    int ranks = CORTEX_SQUARE_RANK(a) - CORTEX_SQUARE_RANK(b);
+    int files = CORTEX_SQUARE_FILE(a) - CORTEX_SQUARE_FILE(b);
+
+    return !ranks || !files || ranks == files || ranks == -files;
+}
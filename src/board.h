@@ -4,24 +4,78 @@
  * board type
  */
 
+#include "eval_nnue.h"
 #include "move.h"
 #include "move_list.h"
 #include "piece.h"
 #include "square.h"
 #include "square_list.h"
 
+/* Sets of squares are 64-bit masks, one bit per square. */
+#define CORTEX_BOARD_SQUARE_BIT(s) (1ULL << (s))
+
+/*
+ * Keys kept for repetition detection. Only positions since the last capture or pawn move can repeat, and the
+ * fifty-move rule ends the game before there are 100 of them, so the history is a ring of the most recent ones.
+ */
+#define CORTEX_BOARD_KEY_HISTORY 128
+
 typedef struct _cortex_board {
     cortex_piece state[64];
     cortex_move_list legal_moves;
     cortex_move_list move_history;
     int color_to_move;
+    uint64_t key; /* zobrist key of the position, including the color to move and en passant file */
+    uint64_t key_history[CORTEX_BOARD_KEY_HISTORY]; /* key after each number of moves played, modulo the size */
+    int halfmove_clock; /* moves since the last capture or pawn move */
+
+    /* Evaluation terms kept up to date by each move, so a static evaluation doesn't scan the board. */
+    int32_t material; /* white-black */
+    int32_t phase; /* phase weight of the pieces left, see CORTEX_EVAL_PHASE_MAX */
+    int32_t psq; /* packed midgame and endgame piece-square scores with material, white-black */
+    cortex_eval_nnue_accumulator nnue; /* only kept while a network is loaded */
+
+    /* Attack information of the position, set when its legal moves are generated. */
+    uint64_t attacks[2]; /* squares attacked by each color */
+    cortex_square king[2]; /* king squares, CORTEX_SQUARE_INVALID if missing */
 } cortex_board;
 
 int cortex_board_init(cortex_board* dst);
+
+/*
+ * Set up a position from Forsyth-Edwards Notation. The board has no castling, so that field is skipped.
+ * The halfmove clock is optional and anything after it is ignored.
+ * Returns -1 on malformed input.
+ */
+int cortex_board_set_fen(cortex_board* dst, const char* fen);
+
+/*
+ * Recompute the position key and evaluation terms from the state and restart the key history.
+ * Needed after editing the state directly.
+ */
+int cortex_board_update_key(cortex_board* dst);
+
+/* Recompute only the evaluation terms, keeping the key history. Needed after changing the evaluation weights. */
+int cortex_board_update_scores(cortex_board* dst);
+
+/*
+ * Check if the position is drawn by the fifty-move rule, or by repetition if it has occurred
+ * <repetitions> times before. Only positions since the last capture or pawn move are compared.
+ */
+int cortex_board_is_draw(cortex_board* dst, int repetitions);
 void cortex_board_draw_types(cortex_board* dst);
 
+/* Get the set of squares attacked by the piece on a square. */
+uint64_t cortex_board_get_attacks(cortex_board* dst, cortex_square sq);
+
+/* Get the squares of the pieces of either color attacking a square, treating the squares in <removed> as empty. */
+uint64_t cortex_board_get_attackers(cortex_board* dst, cortex_square sq, uint64_t removed);
+
 int cortex_board_add_attacked_squares(cortex_board* dst, cortex_square sq, cortex_square_list* out);
 
+/* Compute the attack sets and king squares. Done by cortex_board_gen_legal_moves. */
+int cortex_board_update_attacks(cortex_board* dst);
+
 /* Get squares attacked by a color. */
 int cortex_board_add_attacked_squares_color(cortex_board* dst, cortex_piece_color col, cortex_square_list* out);
 
@@ -33,6 +87,7 @@ int cortex_board_apply_move_unchecked_copy(cortex_board* dst, cortex_board* resu
 /*
  * Partially applies a move.
  * Copies the board state, applies a move, analyzes any reminaing move attributes.
+ * Relies on the attack sets of <dst>, so its legal moves must have been generated.
  * Returns -1 on invalid arguments or illegal moves.
  */
 int cortex_board_complete_move(cortex_board* dst, cortex_move* move, cortex_board* out);
@@ -0,0 +1,12 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "clock.h"
+
+#include <time.h>
+
+uint64_t cortex_clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+/*
+ * monotonic wall clock
+ */
+
+#include <stdint.h>
+
+/* Milliseconds since an arbitrary fixed point. */
+uint64_t cortex_clock_ms();
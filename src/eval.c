@@ -1,249 +1,1535 @@
 #include "eval.h"
 #include "eval_cache.h"
+#include "eval_endgame.h"
+#include "eval_split.h"
+#include "eval_mcts.h"
+#include "eval_time.h"
+#include "clock.h"
 
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 
-static cortex_eval _cortex_eval_position_sub(cortex_board* b, int depth);
-static float _cortex_clamp(float x);
+static void* _cortex_eval_main(void* arg);
+static void* _cortex_eval_thread_main(void* arg);
+static void _cortex_eval_iterate(cortex_eval_thread* t);
+static cortex_score _cortex_eval_root(cortex_eval_thread* t, int depth, cortex_score guess);
+static void _cortex_eval_mcts_run(cortex_eval_thread* t);
+static void _cortex_eval_mcts_line();
+static cortex_score _cortex_eval_search(cortex_eval_thread* t, cortex_board* b, int depth, int ply, cortex_score alpha, cortex_score beta);
+static cortex_score _cortex_eval_quiesce(cortex_eval_thread* t, cortex_board* b, int ply, cortex_score alpha, cortex_score beta, int endgame, cortex_score known);
+static int _cortex_eval_search_move(cortex_eval_thread* t, cortex_board* b, cortex_move move, int index, int depth, int ply, int flags, cortex_score alpha, cortex_score beta, cortex_score best_score, cortex_score* out);
+static void _cortex_eval_split(cortex_eval_thread* t, cortex_board* b, cortex_move* moves, int count, int depth, int ply, int flags, cortex_score* alpha, cortex_score beta, cortex_score* best_score, cortex_move* best_move);
+static void _cortex_eval_run_task(cortex_eval_thread* t, cortex_eval_split_task task);
+static int _cortex_eval_steal(cortex_eval_thread* t, cortex_eval_split* within, cortex_eval_split_task* out);
+static void _cortex_eval_work(cortex_eval_thread* t);
+static int _cortex_eval_aborted(cortex_eval_thread* t);
+static void _cortex_eval_count_node(cortex_eval_thread* t);
+static cortex_score _cortex_eval_static(cortex_board* b, int endgame, cortex_score known, cortex_score alpha, cortex_score beta);
+/* Pawn and bishop counts from one scan of the board, by color. Pawn files are padded with an empty file either side. */
+typedef struct _cortex_eval_scan {
+    int pawns[2][10];
+    int lowest[2][10], highest[2][10]; /* ranks of the lowest and highest pawn on each file */
+    int bishops[2];
+} cortex_eval_scan;
+
+static void _cortex_eval_positional_counts(cortex_board* b, int32_t* counts);
+static inline void _cortex_eval_positional_side(cortex_board* b, cortex_eval_scan* scan, cortex_piece_color col, int32_t* counts, int sign) __attribute__((always_inline));
+static int _cortex_eval_piece_weight(cortex_piece p);
+static int _cortex_eval_piece_terms(cortex_piece p, cortex_square sq, int* weights, int* counts);
+static cortex_score _cortex_eval_see_value(cortex_piece p);
+static int _cortex_eval_move_order(cortex_move m, cortex_board* b, cortex_move* hash_move);
+static void _cortex_eval_report(int force);
+static uint64_t _cortex_eval_nodes();
+static void _cortex_eval_check_time();
+static void _cortex_eval_search_lines(cortex_eval_thread* t, int depth);
+static int _cortex_eval_excluded(cortex_eval_thread* t, cortex_move m);
+static int _cortex_eval_pv(cortex_board* b, cortex_move first, cortex_move* out, int max);
+static void _cortex_eval_init_tables();
+static void _cortex_eval_init_lmr();
+
+/* Evaluation weights, starting from the defaults in eval_weights.h. */
+#define CORTEX_EVAL_WEIGHT_PAIR(name, mg, eg) CORTEX_EVAL_PAIR(mg, eg),
+#define CORTEX_EVAL_WEIGHT_NAME(name, mg, eg) #name,
+
+cortex_eval_pair cortex_eval_weights[CORTEX_EVAL_WEIGHT_COUNT] = { CORTEX_EVAL_WEIGHTS(CORTEX_EVAL_WEIGHT_PAIR) };
+const char* cortex_eval_weight_names[CORTEX_EVAL_WEIGHT_COUNT] = { CORTEX_EVAL_WEIGHTS(CORTEX_EVAL_WEIGHT_NAME) };
+
+static const cortex_eval_pair _cortex_eval_weight_defaults[CORTEX_EVAL_WEIGHT_COUNT] = { CORTEX_EVAL_WEIGHTS(CORTEX_EVAL_WEIGHT_PAIR) };
+
+/* Names of the weight halves as parameters. */
+#define CORTEX_EVAL_WEIGHT_PARAM_NAMES(name, mg, eg) #name "_MG", #name "_EG",
+
+static const char* _cortex_eval_weight_param_names[2 * CORTEX_EVAL_WEIGHT_COUNT] = { CORTEX_EVAL_WEIGHTS(CORTEX_EVAL_WEIGHT_PARAM_NAMES) };
+
+/* Search constants, tunable at runtime by name. LMR_BASE and LMR_DIVISOR are in hundredths. */
+static int _cortex_eval_depth = CORTEX_EVAL_DEPTH;
+static int _cortex_eval_aspiration_window = CORTEX_EVAL_ASPIRATION_WINDOW;
+static int _cortex_eval_futility_margin = CORTEX_EVAL_FUTILITY_MARGIN;
+static int _cortex_eval_reverse_futility_margin = CORTEX_EVAL_REVERSE_FUTILITY_MARGIN;
+static int _cortex_eval_razor_margin = CORTEX_EVAL_RAZOR_MARGIN;
+static int _cortex_eval_probcut_margin = CORTEX_EVAL_PROBCUT_MARGIN;
+static int _cortex_eval_lazy_margin = CORTEX_EVAL_LAZY_MARGIN;
+static int _cortex_eval_lmr_base = (int) (CORTEX_EVAL_LMR_BASE * 100);
+static int _cortex_eval_lmr_divisor = (int) (CORTEX_EVAL_LMR_DIVISOR * 100);
+
+typedef struct _cortex_eval_param {
+    const char* name;
+    int* value;
+    int min, max, step; /* step is the typical perturbation when tuning */
+} cortex_eval_param;
+
+static const cortex_eval_param _cortex_eval_params[] = {
+    { "DEPTH", &_cortex_eval_depth, 1, CORTEX_EVAL_MAX_DEPTH, 1 },
+    { "ASPIRATION_WINDOW", &_cortex_eval_aspiration_window, 5, 500, 5 },
+    { "FUTILITY_MARGIN", &_cortex_eval_futility_margin, 0, 1000, 15 },
+    { "REVERSE_FUTILITY_MARGIN", &_cortex_eval_reverse_futility_margin, 0, 1000, 15 },
+    { "RAZOR_MARGIN", &_cortex_eval_razor_margin, 0, 2000, 25 },
+    { "PROBCUT_MARGIN", &_cortex_eval_probcut_margin, 0, 2000, 20 },
+    { "LAZY_MARGIN", &_cortex_eval_lazy_margin, 50, 5000, 20 },
+    { "LMR_BASE", &_cortex_eval_lmr_base, 0, 500, 10 },
+    { "LMR_DIVISOR", &_cortex_eval_lmr_divisor, 50, 1000, 20 },
+};
+
+#define CORTEX_EVAL_SEARCH_PARAMS ((int) (sizeof _cortex_eval_params / sizeof *_cortex_eval_params))
+
+/* Late move reduction amounts, indexed by [depth][move number]. */
+static int _cortex_eval_lmr_table[CORTEX_EVAL_MAX_DEPTH + 1][64];
+
+/* Number of quiet moves searched at a shallow depth before the rest are pruned. */
+static int _cortex_eval_lmp_table[CORTEX_EVAL_LMP_DEPTH + 1];
+
+/* Search threads. Thread 0 is the main thread, the rest are helpers. */
+static cortex_eval_thread _cortex_eval_threads[CORTEX_EVAL_MAX_THREADS];
+static int _cortex_eval_thread_count = 1;
+static int _cortex_eval_smp_mode = CORTEX_EVAL_SMP_LAZY;
+static int _cortex_eval_engine = CORTEX_EVAL_ENGINE_ALPHABETA;
+static int _cortex_eval_driver = CORTEX_EVAL_DRIVER_ASPIRATION;
+
+/* Tree shared by the threads of an MCTS search. */
+static cortex_eval_mcts_tree _cortex_eval_mcts;
+
+/* Work-stealing deques, one per thread. */
+static cortex_eval_split_deque _cortex_eval_deques[CORTEX_EVAL_MAX_THREADS];
+
+/* Set by cortex_eval_stop() or once the main thread has finished. Every search node checks it. */
+static int _cortex_eval_stop;
+
+/* The search runs on its own thread, controlled with cortex_eval_start/stop/ponderhit/wait. */
+static pthread_t _cortex_eval_search_thread;
+static int _cortex_eval_running;
+
+/* While pondering the main thread searches without a depth limit until a ponderhit or stop. */
+static int _cortex_eval_pondering;
+static pthread_mutex_t _cortex_eval_control_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _cortex_eval_control_cond = PTHREAD_COND_INITIALIZER;
+
+/* Number of best lines searched at each iteration. */
+static int _cortex_eval_multipv = 1;
+
+/* Progress reporting. The main thread fills in the depth, score and PV of each line as the iterations complete. */
+static cortex_eval_progress_callback _cortex_eval_progress;
+static void* _cortex_eval_progress_data;
+static int _cortex_eval_progress_interval;
+static cortex_eval_info _cortex_eval_lines[CORTEX_EVAL_MAX_MULTIPV];
+static int _cortex_eval_line_count;
+static uint64_t _cortex_eval_start_ms, _cortex_eval_report_ms;
+
+/* Clock for time managed searches. Without one, searches stop at CORTEX_EVAL_DEPTH. */
+static int _cortex_eval_clock_ms, _cortex_eval_clock_inc_ms, _cortex_eval_clock_moves;
+static int _cortex_eval_timed;
+static int _cortex_eval_time_pondered; /* the clock restarts when a ponder turns into the real search */
+static cortex_eval_time _cortex_eval_time;
+
+/* Result of the last finished search. */
+static cortex_score _cortex_eval_result;
+static cortex_move _cortex_eval_result_move;
+
+void cortex_eval_set_threads(int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > CORTEX_EVAL_MAX_THREADS) threads = CORTEX_EVAL_MAX_THREADS;
+
+    _cortex_eval_thread_count = threads;
+}
+
+void cortex_eval_set_smp_mode(int mode) {
+    _cortex_eval_smp_mode = mode;
+}
+
+void cortex_eval_set_clock(int time_ms, int inc_ms, int moves_to_go) {
+    _cortex_eval_clock_ms = time_ms;
+    _cortex_eval_clock_inc_ms = inc_ms;
+    _cortex_eval_clock_moves = moves_to_go;
+}
+
+void cortex_eval_set_driver(int driver) {
+    _cortex_eval_driver = driver;
+}
+
+void cortex_eval_set_engine(int engine) {
+    _cortex_eval_engine = engine;
+}
+
+void cortex_eval_set_multipv(int lines) {
+    if (lines < 1) lines = 1;
+    if (lines > CORTEX_EVAL_MAX_MULTIPV) lines = CORTEX_EVAL_MAX_MULTIPV;
+
+    _cortex_eval_multipv = lines;
+}
+
+void cortex_eval_set_progress(cortex_eval_progress_callback cb, void* data, int interval_ms) {
+    _cortex_eval_progress = cb;
+    _cortex_eval_progress_data = data;
+    _cortex_eval_progress_interval = interval_ms;
+}
+
+/* Evaluation function. Runs a search and waits for it to finish. */
+int cortex_eval_position(cortex_board* b, cortex_move* best_move, cortex_score* score) {
+    if (cortex_eval_start(b, 0)) return -1;
+
+    cortex_score result = cortex_eval_wait(best_move);
+    if (score) *score = result;
+
+    return 0;
+}
+
+int cortex_eval_start(cortex_board* b, int ponder) {
+    if (!b || _cortex_eval_running) return -1;
+
+    _cortex_eval_init_tables();
+
+    __atomic_store_n(&_cortex_eval_stop, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&_cortex_eval_pondering, ponder, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < _cortex_eval_thread_count; ++i) {
+        cortex_eval_thread* t = _cortex_eval_threads + i;
+
+        t->id = i;
+        t->depth = 0;
+        t->score = 0;
+        t->nodes = 0;
+        t->split = NULL;
+        t->excluded_count = 0;
+        memcpy(&t->root, b, sizeof t->root);
+
+        if (b->legal_moves.len) t->root_move = b->legal_moves.list[0];
+    }
+
+    memset(_cortex_eval_lines, 0, sizeof _cortex_eval_lines);
+    _cortex_eval_lines[0].multipv = 1;
+    _cortex_eval_line_count = 1;
+
+    _cortex_eval_start_ms = _cortex_eval_report_ms = cortex_clock_ms();
+
+    _cortex_eval_timed = (_cortex_eval_clock_ms > 0);
+    _cortex_eval_time_pondered = ponder;
+
+    if (_cortex_eval_timed) {
+        cortex_eval_time_init(&_cortex_eval_time, _cortex_eval_clock_ms, _cortex_eval_clock_inc_ms, _cortex_eval_clock_moves, _cortex_eval_start_ms);
+    }
+
+    if (_cortex_eval_engine == CORTEX_EVAL_ENGINE_MCTS && cortex_eval_mcts_init(&_cortex_eval_mcts, b, CORTEX_EVAL_MCTS_MEMORY)) return -1;
+
+    if (pthread_create(&_cortex_eval_search_thread, NULL, _cortex_eval_main, NULL)) {
+        if (_cortex_eval_engine == CORTEX_EVAL_ENGINE_MCTS) cortex_eval_mcts_free(&_cortex_eval_mcts);
+        return -1;
+    }
+
+    _cortex_eval_running = 1;
+    return 0;
+}
+
+void cortex_eval_stop() {
+    pthread_mutex_lock(&_cortex_eval_control_lock);
+    __atomic_store_n(&_cortex_eval_stop, 1, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&_cortex_eval_control_cond);
+    pthread_mutex_unlock(&_cortex_eval_control_lock);
+}
+
+void cortex_eval_ponderhit() {
+    pthread_mutex_lock(&_cortex_eval_control_lock);
+    __atomic_store_n(&_cortex_eval_pondering, 0, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&_cortex_eval_control_cond);
+    pthread_mutex_unlock(&_cortex_eval_control_lock);
+}
+
+cortex_score cortex_eval_wait(cortex_move* best_move) {
+    if (!_cortex_eval_running) return 0;
+
+    pthread_join(_cortex_eval_search_thread, NULL);
+    _cortex_eval_running = 0;
+
+    if (best_move) *best_move = _cortex_eval_result_move;
+
+    return _cortex_eval_result;
+}
+
+/*
+ * Search thread.
+ * Every thread iteratively deepens the same root, so each iteration is ordered by the best moves
+ * cached by the previous ones and by the other threads. The deepest completed result wins.
+ */
+static void* _cortex_eval_main(void* arg) {
+    pthread_t helpers[CORTEX_EVAL_MAX_THREADS];
+    int helper_count = 0;
+
+    for (int i = 1; i < _cortex_eval_thread_count; ++i) {
+        if (!pthread_create(helpers + helper_count, NULL, _cortex_eval_thread_main, _cortex_eval_threads + i)) {
+            ++helper_count;
+        }
+    }
+
+    if (_cortex_eval_engine == CORTEX_EVAL_ENGINE_MCTS) {
+        _cortex_eval_mcts_run(_cortex_eval_threads);
+    } else {
+        _cortex_eval_iterate(_cortex_eval_threads);
+    }
+
+    /* A pondering search never finishes on its own, its result is only wanted after a ponderhit or stop. */
+    pthread_mutex_lock(&_cortex_eval_control_lock);
+
+    while (__atomic_load_n(&_cortex_eval_pondering, __ATOMIC_RELAXED) && !__atomic_load_n(&_cortex_eval_stop, __ATOMIC_RELAXED)) {
+        pthread_cond_wait(&_cortex_eval_control_cond, &_cortex_eval_control_lock);
+    }
+
+    __atomic_store_n(&_cortex_eval_stop, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&_cortex_eval_control_lock);
+
+    for (int i = 0; i < helper_count; ++i) {
+        pthread_join(helpers[i], NULL);
+    }
+
+    if (_cortex_eval_engine == CORTEX_EVAL_ENGINE_MCTS) {
+        cortex_board* b = &_cortex_eval_threads[0].root;
+
+        if (cortex_eval_mcts_best(&_cortex_eval_mcts, &_cortex_eval_result_move, &_cortex_eval_result)) {
+            _cortex_eval_result = cortex_eval_in_check(b) ? -CORTEX_SCORE_MATE : 0;
+        }
+
+        cortex_eval_mcts_free(&_cortex_eval_mcts);
+        return NULL;
+    }
+
+    /* Take the deepest completed iteration. The main thread wins ties. */
+    cortex_eval_thread* best = _cortex_eval_threads;
+
+    for (int i = 1; i < _cortex_eval_thread_count; ++i) {
+        cortex_eval_thread* t = _cortex_eval_threads + i;
+        if (t->depth > best->depth) best = t;
+    }
+
+    _cortex_eval_result = best->score;
+    _cortex_eval_result_move = best->best_move;
+
+    /* Stopped before even one iteration finished, any legal move is better than nothing. */
+    if (!best->depth) {
+        _cortex_eval_result_move = best->root_move;
+    }
+
+    return NULL;
+}
+
+static void* _cortex_eval_thread_main(void* arg) {
+    if (_cortex_eval_engine == CORTEX_EVAL_ENGINE_MCTS) {
+        _cortex_eval_mcts_run(arg);
+    } else if (_cortex_eval_smp_mode == CORTEX_EVAL_SMP_YBWC) {
+        _cortex_eval_work(arg);
+    } else {
+        _cortex_eval_iterate(arg);
+    }
+
+    return NULL;
+}
+
+/*
+ * Iterative deepening for one thread.
+ * Odd helpers start one ply deeper so the threads spread over neighbouring depths instead of
+ * all racing through the same tree.
+ */
+static void _cortex_eval_iterate(cortex_eval_thread* t) {
+    cortex_board* b = &t->root;
+
+    /* A known draw can't be searched into anything else. */
+    cortex_score known;
+    int drawn = cortex_eval_endgame_probe(b, &known) == CORTEX_EVAL_ENDGAME_DRAW;
+
+    for (int depth = 1 + (t->id & 1); depth <= CORTEX_EVAL_MAX_DEPTH; ++depth) {
+        cortex_score score = _cortex_eval_root(t, depth, t->score);
+        if (__atomic_load_n(&_cortex_eval_stop, __ATOMIC_RELAXED)) break;
+
+        t->score = score;
+        t->depth = depth;
+        t->best_move = t->root_move;
+
+        if (!t->id) _cortex_eval_search_lines(t, depth);
+
+        if (CORTEX_SCORE_IS_MATE(score) || !b->legal_moves.len || drawn) break;
+
+        /* Helpers keep going until the main thread is done. */
+        if (t->id) continue;
+
+        int pondering = __atomic_load_n(&_cortex_eval_pondering, __ATOMIC_RELAXED);
+
+        if (_cortex_eval_timed) {
+            _cortex_eval_check_time();
+
+            /* Iterations while pondering still feed the branching factor. */
+            int next = cortex_eval_time_next(&_cortex_eval_time, t->best_move, score, _cortex_eval_nodes(), cortex_clock_ms());
+            if (!next && !pondering) break;
+        } else if (depth >= _cortex_eval_depth && !pondering) {
+            break;
+        }
+    }
+}
+
+/*
+ * Search the root to <depth> with the selected driver. <guess> is the score of the previous iteration.
+ * Leaves the best move in t->root_move like a plain search.
+ */
+static cortex_score _cortex_eval_root(cortex_eval_thread* t, int depth, cortex_score guess) {
+    cortex_board* b = &t->root;
+
+    if (_cortex_eval_driver == CORTEX_EVAL_DRIVER_MTDF) {
+        /*
+         * Every null-window search moves one bound towards the true score, until they meet.
+         * Only a search failing high proves a move is as good as its score, so the best move comes from the last of those.
+         */
+        cortex_score lower = -CORTEX_SCORE_INFINITY, upper = CORTEX_SCORE_INFINITY, g = guess;
+        cortex_move best_move = t->root_move;
+
+        while (lower < upper) {
+            cortex_score beta = (g == lower) ? g + 1 : g;
+
+            g = _cortex_eval_search(t, b, depth, 0, beta - 1, beta);
+            if (__atomic_load_n(&_cortex_eval_stop, __ATOMIC_RELAXED)) break;
+
+            if (g < beta) {
+                upper = g;
+            } else {
+                lower = g;
+                best_move = t->root_move;
+            }
+        }
+
+        t->root_move = best_move;
+        return g;
+    }
+
+    if (depth < CORTEX_EVAL_ASPIRATION_DEPTH || CORTEX_SCORE_IS_MATE(guess)) {
+        return _cortex_eval_search(t, b, depth, 0, -CORTEX_SCORE_INFINITY, CORTEX_SCORE_INFINITY);
+    }
+
+    cortex_score delta = _cortex_eval_aspiration_window;
+    cortex_score alpha = guess - delta, beta = guess + delta;
+
+    for (;;) {
+        cortex_score score = _cortex_eval_search(t, b, depth, 0, alpha, beta);
+        if (__atomic_load_n(&_cortex_eval_stop, __ATOMIC_RELAXED)) return score;
+
+        if (score > alpha && score < beta) return score;
+
+        delta *= 2;
+
+        if (score <= alpha) {
+            alpha = score - delta;
+            if (alpha <= -CORTEX_SCORE_MATE_BOUND) alpha = -CORTEX_SCORE_INFINITY;
+        } else {
+            beta = score + delta;
+            if (beta >= CORTEX_SCORE_MATE_BOUND) beta = CORTEX_SCORE_INFINITY;
+        }
+    }
+}
+
+/*
+ * MCTS playouts for one thread, until stopped. The main thread also ends a normal search once it has
+ * run enough playouts, and reports the most visited line as it goes.
+ */
+static void _cortex_eval_mcts_run(cortex_eval_thread* t) {
+    if (!t->root.legal_moves.len) return;
+
+    while (!__atomic_load_n(&_cortex_eval_stop, __ATOMIC_RELAXED)) {
+        cortex_eval_mcts_playout(&_cortex_eval_mcts);
+        ++t->nodes;
+
+        if (t->id) continue;
+
+        if (!(t->nodes & 0xFF)) {
+            _cortex_eval_check_time();
+
+            if (_cortex_eval_progress) {
+                _cortex_eval_mcts_line();
+                _cortex_eval_report(0);
+            }
+        }
+
+        if (__atomic_load_n(&_cortex_eval_pondering, __ATOMIC_RELAXED)) continue;
+
+        /* With a clock, playouts go on for the optimum time instead of a fixed count. */
+        if (_cortex_eval_timed) {
+            if (!(t->nodes & 0xFF) && cortex_clock_ms() - _cortex_eval_time.start_ms >= _cortex_eval_time.optimum_ms) break;
+        } else if (cortex_eval_mcts_playouts(&_cortex_eval_mcts) >= CORTEX_EVAL_MCTS_PLAYOUTS) {
+            break;
+        }
+    }
+
+    if (!t->id) {
+        _cortex_eval_mcts_line();
+        _cortex_eval_report(1);
+    }
+}
+
+/* Describe the MCTS tree as the first line. The depth is the length of the most visited line. */
+static void _cortex_eval_mcts_line() {
+    cortex_eval_info* line = _cortex_eval_lines;
+
+    cortex_eval_mcts_best(&_cortex_eval_mcts, NULL, &line->score);
+    line->pv_len = cortex_eval_mcts_pv(&_cortex_eval_mcts, line->pv, CORTEX_EVAL_MAX_DEPTH);
+    line->depth = line->pv_len;
+}
 
 /*
- * Evaluation function.
- * Recursively
+ * Fill in the lines of a completed iteration on the main thread and report them.
+ * Line 1 is the iteration just searched. Each further line searches the root again with the first
+ * moves of the lines before it excluded, reusing everything the earlier searches left in the cache.
  */
-cortex_eval cortex_eval_position(cortex_board* b) {
-    return _cortex_eval_position_sub(b, CORTEX_EVAL_DEPTH);
+static void _cortex_eval_search_lines(cortex_eval_thread* t, int depth) {
+    cortex_board* b = &t->root;
+    int count = _cortex_eval_multipv < b->legal_moves.len ? _cortex_eval_multipv : b->legal_moves.len;
+    cortex_move move = t->best_move;
+    cortex_score score = t->score;
+
+    if (count < 1) count = 1;
+
+    for (int i = 0; i < count; ++i) {
+        if (i) {
+            t->excluded[t->excluded_count++] = move;
+
+            score = _cortex_eval_search(t, b, depth, 0, -CORTEX_SCORE_INFINITY, CORTEX_SCORE_INFINITY);
+            if (__atomic_load_n(&_cortex_eval_stop, __ATOMIC_RELAXED)) break;
+
+            move = t->root_move;
+        }
+
+        cortex_eval_info* line = _cortex_eval_lines + i;
+
+        line->multipv = i + 1;
+        line->depth = depth;
+        line->score = score;
+        line->pv_len = b->legal_moves.len ? _cortex_eval_pv(b, move, line->pv, depth) : 0;
+
+        if (i >= _cortex_eval_line_count) _cortex_eval_line_count = i + 1;
+    }
+
+    t->excluded_count = 0;
+    _cortex_eval_report(1);
 }
 
-cortex_eval _cortex_eval_position_sub(cortex_board* b, int depth) {
+/*
+ * Alpha-beta search.
+ * Scores and the window are relative to the color to move.
+ */
+cortex_score _cortex_eval_search(cortex_eval_thread* t, cortex_board* b, int depth, int ply, cortex_score alpha, cortex_score beta) {
     int has_a_move = 0;
 
-    cortex_eval out;
-    out.evaluation = 0.0f;
-    out.found_mate = 0;
-    out.mate_in = 0;
-    out.game_over = 0;
+    /* Unwind as soon as the search is stopped. The result is thrown away. */
+    if (_cortex_eval_aborted(t)) return 0;
 
-    cortex_eval best_next_eval;
+    _cortex_eval_count_node(t);
 
-    if (!depth) {
+    /* A repeated position or fifty quiet moves is a draw, no matter what lies below. Mates still stand. */
+    if (ply && b->legal_moves.len && cortex_board_is_draw(b, 1)) return 0;
+
+    /* So is a known drawn endgame. The probe is kept for the static evaluations below. */
+    cortex_score known;
+    int endgame = cortex_eval_endgame_probe(b, &known);
+    if (ply && endgame == CORTEX_EVAL_ENDGAME_DRAW) return 0;
+
+    if (depth <= 0) {
         /*
          * Don't look any further.
-         * Do a basic evaluation of the position.
+         * Resolve the captures on the board and evaluate the quiet position.
          */
 
-        out.evaluation = cortex_eval_immediate(b);
-        return out;
+        return _cortex_eval_quiesce(t, b, ply, alpha, beta, endgame, known);
     }
 
-    /* Check if there is a cached evaluation at an acceptable depth. */
-    int cached_depth;
-    cortex_eval cached_eval;
+    int in_check = cortex_eval_in_check(b);
+
+    if (!b->legal_moves.len) {
+        return in_check ? -CORTEX_SCORE_MATE + ply : 0;
+    }
+
+    cortex_score alpha_orig = alpha, best_score = -CORTEX_SCORE_INFINITY;
+    cortex_move best_move;
+    /* The root is always treated as a PV node, so null-window drivers never prune away its moves. */
+    int pv_node = (beta - alpha > 1) || !ply;
 
-    if (cortex_eval_try_cache(b, &cached_eval, &cached_depth)) {
-        /* Got a cache hit. Accept it if it evaluated to the depth we need. */
+    /* Check if there is a cached evaluation at an acceptable depth. */
+    int cached_depth, cached_bound;
+    cortex_score cached_score;
+    cortex_move cached_move;
+    cortex_move* hash_move = NULL;
 
-        if (cached_depth >= depth) {
-            return cached_eval;
+    if (cortex_eval_try_cache(b, ply, &cached_score, &cached_move, &cached_depth, &cached_bound)) {
+        /* Got a cache hit. Accept it if it evaluated to the depth we need and it bounds the window. */
+        if (ply && cached_depth >= depth) {
+            if (cached_bound == CORTEX_EVAL_CACHE_EXACT) return cached_score;
+            if (cached_bound == CORTEX_EVAL_CACHE_LOWER && cached_score >= beta) return cached_score;
+            if (cached_bound == CORTEX_EVAL_CACHE_UPPER && cached_score <= alpha) return cached_score;
         }
+
+        /* Otherwise the cached best move is still the best guess to search first. */
+        hash_move = &cached_move;
     }
 
     /* Cache either missed or was not deep enough. Evaluate from scratch and re-cache the position. */
 
-    /* Iterate through the next legal moves. */
-    /* Evaluate each board and find the min-maxed best move. */
+    /* Near the frontier, a static evaluation far outside the window decides the node without a full search. */
+    int futile = 0;
+
+    if (!pv_node && !in_check && depth <= CORTEX_EVAL_FRONTIER_DEPTH) {
+        cortex_score static_score = _cortex_eval_static(b, endgame, known, alpha, beta);
+
+        /*
+         * Reverse futility: even giving up a margin, the position fails high.
+         * The static score may be a lazy estimate here, so only the bound is returned. A recognized endgame is
+         * scored exactly, and keeping its score lets the search tell a closer mating net from a looser one.
+         */
+        if (static_score - _cortex_eval_reverse_futility_margin * depth >= beta) {
+            return endgame ? static_score : beta;
+        }
+
+        /* Razoring: far below alpha, only captures can save the position. */
+        if (static_score + _cortex_eval_razor_margin * depth <= alpha) {
+            cortex_score q = _cortex_eval_quiesce(t, b, ply, alpha, beta, endgame, known);
+            if (q <= alpha) return q;
+        }
+
+        /* Futility: quiet moves can't make up the difference, only search the rest. */
+        futile = (static_score + _cortex_eval_futility_margin * depth <= alpha);
+    }
+
+    /*
+     * ProbCut: deep in non-PV nodes, if a good capture clearly beats beta at a much shallower depth
+     * it will almost certainly beat it at full depth too.
+     */
+    if (!pv_node && !in_check && depth >= CORTEX_EVAL_PROBCUT_DEPTH && !CORTEX_SCORE_IS_MATE(beta)) {
+        cortex_score raised_beta = beta + _cortex_eval_probcut_margin;
+        cortex_score static_score = _cortex_eval_static(b, endgame, known, alpha, beta);
+
+        for (int i = 0; i < b->legal_moves.len; ++i) {
+            cortex_move move = b->legal_moves.list[i];
+
+            if (move.move_type != CORTEX_MOVE_TYPE_CAPTURE) continue;
+            if (static_score + cortex_eval_see(b, move) < raised_beta) continue;
+
+            cortex_board tmp_board;
+            memcpy(&tmp_board, b, sizeof tmp_board);
+            cortex_board_apply_move(&tmp_board, move);
+
+            cortex_score score = -_cortex_eval_search(t, &tmp_board, depth - CORTEX_EVAL_PROBCUT_REDUCTION, ply + 1, -raised_beta, -raised_beta + 1);
+
+            if (score >= raised_beta) return score;
+        }
+    }
+
+    /* Score the moves for ordering. Moves are picked best-first as the search goes. */
+    int order[b->legal_moves.len];
+    int order_score[b->legal_moves.len];
+
+    int move_count = b->legal_moves.len;
+
     for (int i = 0; i < b->legal_moves.len; ++i) {
-        if (depth == CORTEX_EVAL_DEPTH) {
-            printf("Evaluating top-level move %d of %d : current best ", i+1, b->legal_moves.len);
+        order[i] = i;
+        order_score[i] = _cortex_eval_move_order(b->legal_moves.list[i], b, hash_move);
 
-            if (has_a_move) {
-                cortex_move_print_basic(out.best_move);
-            } else {
-                printf("\n");
+        /* Root moves already reported as better lines are ordered last and never reached. */
+        if (!ply && t->excluded_count && _cortex_eval_excluded(t, b->legal_moves.list[i])) {
+            order_score[i] = INT_MIN;
+            --move_count;
+        }
+    }
+
+    int flags = (in_check ? CORTEX_EVAL_NODE_IN_CHECK : 0) | (pv_node ? CORTEX_EVAL_NODE_PV : 0) | (futile ? CORTEX_EVAL_NODE_FUTILE : 0);
+
+    /* Iterate through the next legal moves. */
+    /* Evaluate each board and find the best move for the color to move. */
+    for (int i = 0; i < move_count; ++i) {
+        for (int j = i + 1; j < b->legal_moves.len; ++j) {
+            if (order_score[j] > order_score[i]) {
+                int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+                tmp = order_score[i]; order_score[i] = order_score[j]; order_score[j] = tmp;
             }
         }
 
+        cortex_move move = b->legal_moves.list[order[i]];
+
         /* If a move delivers mate, it must be (a) best move. */
-        if (b->legal_moves.list[i].move_attr & CORTEX_MOVE_ATTR_MATE) {
-            out.found_mate = 1;
-            out.mate_in = (b->color_to_move == CORTEX_PIECE_COLOR_WHITE) ? 1 : -1;
-            out.best_move = b->legal_moves.list[i];
-            return out;
+        if (move.move_attr & CORTEX_MOVE_ATTR_MATE) {
+            if (!ply) t->root_move = move;
+            return CORTEX_SCORE_MATE - (ply + 1);
         }
 
-        /* Duplicate the board and evaluate it with a move applied. */
-        cortex_board tmp_board;
-        memcpy(&tmp_board, b, sizeof tmp_board);
-        cortex_board_apply_move(&tmp_board, b->legal_moves.list[i]);
+        cortex_score score;
+        if (!_cortex_eval_search_move(t, b, move, i, depth, ply, flags, alpha, beta, best_score, &score)) continue;
 
-        cortex_eval tmp_eval = _cortex_eval_position_sub(&tmp_board, depth - 1);
-
-        /* Always take the first evaluated move as the best. */
-        if (!has_a_move) {
+        if (!has_a_move || score > best_score) {
             has_a_move = 1;
-            best_next_eval = tmp_eval;
-            out.best_move = b->legal_moves.list[i];
-        } else {
-            /* Compare the evaluation for the color to move. */
-            if (cortex_eval_compare(best_next_eval, tmp_eval, b->color_to_move)) {
-                best_next_eval = tmp_eval;
-                out.best_move = b->legal_moves.list[i];
+            best_score = score;
+            best_move = move;
+        }
+
+        if (best_score > alpha) alpha = best_score;
+        if (alpha >= beta) break;
+
+        /* Young brothers wait: once the first move is searched, the rest may be shared out to idle threads. */
+        int remaining = move_count - i - 1;
+
+        if (!i && _cortex_eval_smp_mode == CORTEX_EVAL_SMP_YBWC && _cortex_eval_thread_count > 1 && depth >= CORTEX_EVAL_SPLIT_DEPTH
+            && remaining >= 2 && cortex_eval_split_deque_free(_cortex_eval_deques + t->id) >= remaining) {
+            cortex_move moves[remaining];
+
+            for (int k = 1; k <= remaining; ++k) {
+                for (int j = k + 1; j < b->legal_moves.len; ++j) {
+                    if (order_score[j] > order_score[k]) {
+                        int tmp = order[k]; order[k] = order[j]; order[j] = tmp;
+                        tmp = order_score[k]; order_score[k] = order_score[j]; order_score[j] = tmp;
+                    }
+                }
+
+                moves[k - 1] = b->legal_moves.list[order[k]];
             }
+
+            _cortex_eval_split(t, b, moves, remaining, depth, ply, flags, &alpha, beta, &best_score, &best_move);
+            break;
+        }
+    }
+
+    /* A stopped search returns garbage from below, it must not reach the cache. */
+    if (_cortex_eval_aborted(t)) return 0;
+
+    if (!ply) t->root_move = best_move;
+
+    /* With root moves excluded the result isn't the value of the position. */
+    if (!ply && t->excluded_count) return best_score;
+
+    /* Cache the new eval if we've made it this far, along with how it relates to the window. */
+    int bound = CORTEX_EVAL_CACHE_EXACT;
+
+    if (best_score <= alpha_orig) {
+        bound = CORTEX_EVAL_CACHE_UPPER;
+    } else if (best_score >= beta) {
+        bound = CORTEX_EVAL_CACHE_LOWER;
+    }
+
+    cortex_eval_cache_insert(b, ply, best_score, best_move, depth, bound);
+
+    return best_score;
+}
+
+/*
+ * Search one move of a node, with the pruning and reductions its place in the move order allows.
+ * <index> is the move number, <best_score> the best score found at the node so far.
+ * Returns 0 if the move was pruned, otherwise fills *out with its score.
+ */
+static int _cortex_eval_search_move(cortex_eval_thread* t, cortex_board* b, cortex_move move, int index, int depth, int ply, int flags, cortex_score alpha, cortex_score beta, cortex_score best_score, cortex_score* out) {
+    int in_check = flags & CORTEX_EVAL_NODE_IN_CHECK;
+    int pv_node = flags & CORTEX_EVAL_NODE_PV;
+    int quiet = (move.move_type == CORTEX_MOVE_TYPE_MOVE) && !(move.move_attr & (CORTEX_MOVE_ATTR_PROMOTE | CORTEX_MOVE_ATTR_CHECK));
+
+    /* Move-count pruning: at shallow depths, quiets ordered this late are not worth a look. */
+    if (quiet && !in_check && !pv_node && depth <= CORTEX_EVAL_LMP_DEPTH && index >= _cortex_eval_lmp_table[depth] && best_score > -CORTEX_SCORE_MATE_BOUND) {
+        return 0;
+    }
+
+    if (quiet && (flags & CORTEX_EVAL_NODE_FUTILE) && best_score > -CORTEX_SCORE_INFINITY) {
+        return 0;
+    }
+
+    /* Duplicate the board and evaluate it with a move applied. */
+    cortex_board tmp_board;
+    memcpy(&tmp_board, b, sizeof tmp_board);
+    cortex_board_apply_move(&tmp_board, move);
+
+    /* Late move reductions: search late quiets shallower with a null window, re-search if they beat alpha. */
+    int reduction = 0;
+
+    if (quiet && !in_check && depth >= CORTEX_EVAL_LMR_DEPTH && index >= CORTEX_EVAL_LMR_MOVES) {
+        reduction = _cortex_eval_lmr_table[depth < CORTEX_EVAL_MAX_DEPTH ? depth : CORTEX_EVAL_MAX_DEPTH][index < 63 ? index : 63];
+        if (pv_node && reduction > 0) --reduction;
+        if (reduction > depth - 2) reduction = depth - 2;
+    }
+
+    if (reduction > 0) {
+        *out = -_cortex_eval_search(t, &tmp_board, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+
+        if (*out > alpha) {
+            *out = -_cortex_eval_search(t, &tmp_board, depth - 1, ply + 1, -beta, -alpha);
         }
+    } else {
+        *out = -_cortex_eval_search(t, &tmp_board, depth - 1, ply + 1, -beta, -alpha);
+    }
+
+    return 1;
+}
+
+/*
+ * Search the remaining moves of a node in parallel.
+ * The moves are pushed onto this thread's deque in reverse, so the owner pops them in search order
+ * while thieves take the least promising ones first. The owner then helps with work below the split
+ * point until every task has finished, and folds the shared window back into the node.
+ */
+static void _cortex_eval_split(cortex_eval_thread* t, cortex_board* b, cortex_move* moves, int count, int depth, int ply, int flags,
+                               cortex_score* alpha, cortex_score beta, cortex_score* best_score, cortex_move* best_move) {
+    cortex_eval_split sp;
+    cortex_eval_split_deque* dq = _cortex_eval_deques + t->id;
+    cortex_eval_split_task task;
+
+    pthread_mutex_init(&sp.lock, NULL);
+    sp.parent = t->split;
+    sp.b = b;
+    sp.moves = moves;
+    sp.first_index = 1;
+    sp.depth = depth;
+    sp.ply = ply;
+    sp.flags = flags;
+    sp.alpha = *alpha;
+    sp.beta = beta;
+    sp.best_score = *best_score;
+    sp.best_move = *best_move;
+    sp.cutoff = 0;
+    sp.pending = count;
+
+    for (int i = count - 1; i >= 0; --i) {
+        task.sp = &sp;
+        task.index = i;
+        cortex_eval_split_push(dq, task);
     }
 
-    if (!has_a_move) {
-        out.game_over = 1;
-        return out;
+    while (cortex_eval_split_pop(dq, &sp, &task)) {
+        _cortex_eval_run_task(t, task);
     }
 
-    /* Consider the best evaluation. Copy over the value, and if there is a found mate then increment the move count. */
-    out.evaluation = best_next_eval.evaluation;
+    /* Everything left was stolen. Help the thieves with work under this node until they are done. */
+    while (__atomic_load_n(&sp.pending, __ATOMIC_ACQUIRE)) {
+        if (!_cortex_eval_steal(t, &sp, &task)) {
+            sched_yield();
+            continue;
+        }
 
-    if (best_next_eval.found_mate) {
-        out.found_mate = 1;
-        out.mate_in = best_next_eval.found_mate;
-        if (out.mate_in < 0) out.mate_in--;
-        if (out.mate_in > 0) out.mate_in++;
+        _cortex_eval_run_task(t, task);
     }
 
-    /* Cache the new eval if we've made it this far. */
-    cortex_eval_cache_insert(b, out, depth);
+    *alpha = sp.alpha;
+    *best_score = sp.best_score;
+    *best_move = sp.best_move;
 
-    return out;
+    pthread_mutex_destroy(&sp.lock);
 }
 
-int cortex_eval_compare(cortex_eval current_best, cortex_eval candidate_best, cortex_piece_color col) {
-    if (col == CORTEX_PIECE_COLOR_WHITE) {
-        if (current_best.found_mate && current_best.mate_in > 0) {
-            /* White has mate on the board. Minimize moves to mate */
-            return (candidate_best.found_mate && candidate_best.mate_in > 0 && candidate_best.mate_in < current_best.mate_in);
-        } else if (current_best.found_mate && current_best.mate_in < 0) {
-            /* Black has mate on board. If the candidate is a non-mate or the candidate is a longer mate, it is a better move. */
-            if (!candidate_best.found_mate) return 1;
+/* Search a move from a split point and fold its score into the shared window. */
+static void _cortex_eval_run_task(cortex_eval_thread* t, cortex_eval_split_task task) {
+    cortex_eval_split* sp = task.sp;
+    cortex_eval_split* outer = t->split;
 
-            if (candidate_best.mate_in < current_best.mate_in || candidate_best.mate_in > 0) {
-                return 1;
-            }
+    t->split = sp;
+
+    pthread_mutex_lock(&sp->lock);
+    cortex_score alpha = sp->alpha, best_score = sp->best_score;
+    pthread_mutex_unlock(&sp->lock);
 
-            return 0;
+    cortex_move move = sp->moves[task.index];
+    cortex_score score;
+
+    if (!_cortex_eval_aborted(t)
+        && _cortex_eval_search_move(t, sp->b, move, sp->first_index + task.index, sp->depth, sp->ply, sp->flags, alpha, sp->beta, best_score, &score)
+        && !_cortex_eval_aborted(t)) {
+        pthread_mutex_lock(&sp->lock);
+
+        if (score > sp->best_score) {
+            sp->best_score = score;
+            sp->best_move = move;
+        }
+
+        if (score > sp->alpha) sp->alpha = score;
+        if (sp->alpha >= sp->beta) __atomic_store_n(&sp->cutoff, 1, __ATOMIC_RELAXED);
+
+        pthread_mutex_unlock(&sp->lock);
+    }
+
+    t->split = outer;
+    __atomic_fetch_sub(&sp->pending, 1, __ATOMIC_RELEASE);
+}
+
+/* Steal a task from any other thread's deque, starting with the next thread along. */
+static int _cortex_eval_steal(cortex_eval_thread* t, cortex_eval_split* within, cortex_eval_split_task* out) {
+    for (int i = 1; i < _cortex_eval_thread_count; ++i) {
+        int victim = (t->id + i) % _cortex_eval_thread_count;
+        if (cortex_eval_split_steal(_cortex_eval_deques + victim, within, out)) return 1;
+    }
+
+    return 0;
+}
+
+/* Idle loop for helper threads in the work-stealing search. */
+static void _cortex_eval_work(cortex_eval_thread* t) {
+    cortex_eval_split_task task;
+
+    while (!__atomic_load_n(&_cortex_eval_stop, __ATOMIC_RELAXED)) {
+        if (_cortex_eval_steal(t, NULL, &task)) {
+            _cortex_eval_run_task(t, task);
         } else {
-            /* Current best is not a mate. If a mate for white is found, choose it, otherwise prefer higher evaluation. */
-            if (candidate_best.found_mate && candidate_best.mate_in > 0) return 1;
-            if (candidate_best.found_mate && candidate_best.mate_in < 0) return 0;
+            sched_yield();
+        }
+    }
+}
+
+/* The search was stopped, or a split point this thread is working under was cut off. */
+static int _cortex_eval_aborted(cortex_eval_thread* t) {
+    return __atomic_load_n(&_cortex_eval_stop, __ATOMIC_RELAXED) || cortex_eval_split_is_cutoff(t->split);
+}
+
+/* Count a searched node. Every 1024 nodes the main thread checks the clock and reports progress. */
+static void _cortex_eval_count_node(cortex_eval_thread* t) {
+    if (++t->nodes & 0x3FF || t->id) return;
+
+    _cortex_eval_check_time();
+    _cortex_eval_report(0);
+}
+
+/*
+ * Quiescence search.
+ * Only captures and promotions are searched, the color to move may always stand pat on the static evaluation.
+ * <endgame> and <known> are the node's endgame probe if the caller already made it, or CORTEX_EVAL_ENDGAME_UNPROBED.
+ */
+static cortex_score _cortex_eval_quiesce(cortex_eval_thread* t, cortex_board* b, int ply, cortex_score alpha, cortex_score beta, int endgame, cortex_score known) {
+    if (_cortex_eval_aborted(t)) return 0;
+
+    _cortex_eval_count_node(t);
+
+    if (!b->legal_moves.len) {
+        return cortex_eval_in_check(b) ? -CORTEX_SCORE_MATE + ply : 0;
+    }
+
+    if (endgame == CORTEX_EVAL_ENDGAME_UNPROBED) endgame = cortex_eval_endgame_probe(b, &known);
+
+    cortex_score stand_pat = _cortex_eval_static(b, endgame, known, alpha, beta);
+
+    /*
+     * Outside the window a lazy static score is only an estimate, so standing pat answers with the window's edges.
+     * A recognized endgame's score is exact and is kept.
+     */
+    if (stand_pat >= beta) return endgame ? stand_pat : beta;
+
+    cortex_score best_score = (stand_pat > alpha) ? stand_pat : alpha;
 
-            return (candidate_best.evaluation > current_best.evaluation);
+    if (ply >= CORTEX_EVAL_MAX_PLY) return best_score;
+    alpha = best_score;
+
+    int order[b->legal_moves.len];
+    int order_score[b->legal_moves.len];
+    int count = 0;
+
+    for (int i = 0; i < b->legal_moves.len; ++i) {
+        cortex_move move = b->legal_moves.list[i];
+
+        /* Mates are free to find, the move generator already marked them. */
+        if (move.move_attr & CORTEX_MOVE_ATTR_MATE) {
+            return CORTEX_SCORE_MATE - (ply + 1);
         }
-    } else {
-        if (current_best.found_mate && current_best.mate_in < 0) {
-            return (candidate_best.found_mate && candidate_best.mate_in < 0 && candidate_best.mate_in > current_best.mate_in);
-        } else if (current_best.found_mate && current_best.mate_in > 0) {
-            if (!candidate_best.found_mate) return 1;
 
-            if (candidate_best.mate_in > current_best.mate_in || candidate_best.mate_in < 0) {
-                return 1;
+        if (move.move_type != CORTEX_MOVE_TYPE_CAPTURE && !(move.move_attr & CORTEX_MOVE_ATTR_PROMOTE)) continue;
+
+        order[count] = i;
+        order_score[count++] = _cortex_eval_move_order(move, b, NULL);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        for (int j = i + 1; j < count; ++j) {
+            if (order_score[j] > order_score[i]) {
+                int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+                tmp = order_score[i]; order_score[i] = order_score[j]; order_score[j] = tmp;
             }
+        }
 
-            return 0;
-        } else {
-            if (candidate_best.found_mate && candidate_best.mate_in < 0) return 1;
-            if (candidate_best.found_mate && candidate_best.mate_in > 0) return 0;
+        cortex_board tmp_board;
+        memcpy(&tmp_board, b, sizeof tmp_board);
+        cortex_board_apply_move(&tmp_board, b->legal_moves.list[order[i]]);
+
+        cortex_score score = -_cortex_eval_quiesce(t, &tmp_board, ply + 1, -beta, -alpha, CORTEX_EVAL_ENDGAME_UNPROBED, 0);
+
+        if (score > best_score) best_score = score;
+        if (best_score > alpha) alpha = best_score;
+        if (alpha >= beta) break;
+    }
+
+    return best_score;
+}
+
+/*
+ * Static evaluation relative to the color to move. Known endgames are scored by their recognizer, from the
+ * <endgame> result and <known> score the caller already probed for the node.
+ * May be lazy outside the window, and then it is only an estimate: it steers pruning but is never returned as a score.
+ */
+static cortex_score _cortex_eval_static(cortex_board* b, int endgame, cortex_score known, cortex_score alpha, cortex_score beta) {
+    if (endgame != CORTEX_EVAL_ENDGAME_NONE) {
+        return (b->color_to_move == CORTEX_PIECE_COLOR_WHITE) ? known : -known;
+    }
+
+    if (b->color_to_move == CORTEX_PIECE_COLOR_WHITE) return cortex_eval_lazy(b, alpha, beta);
+    return -cortex_eval_lazy(b, -beta, -alpha);
+}
+
+/*
+ * Ordering score for a move, higher is searched first.
+ * Mates, then the cached best move, then captures by most valuable victim / least valuable attacker,
+ * then promotions and checks, then quiets.
+ */
+static int _cortex_eval_move_order(cortex_move m, cortex_board* b, cortex_move* hash_move) {
+    if (m.move_attr & CORTEX_MOVE_ATTR_MATE) return 1 << 20;
+
+    if (hash_move && m.from == hash_move->from && m.to == hash_move->to && m.promote_type == hash_move->promote_type) {
+        return 1 << 19;
+    }
+
+    int score = 0;
+
+    if (m.move_type == CORTEX_MOVE_TYPE_CAPTURE) {
+        /* En passant captures land on an empty square. */
+        cortex_score victim = m.is_en_passant ? cortex_eval_piece_value(CORTEX_PIECE_TYPE_PAWN) : cortex_eval_piece_value(b->state[m.to]);
+        cortex_score attacker = cortex_eval_piece_value(b->state[m.from]);
+
+        score += (1 << 16) + victim * 16 - attacker / 10;
+    }
 
-            return (candidate_best.evaluation < current_best.evaluation);
+    if (m.move_attr & CORTEX_MOVE_ATTR_PROMOTE) {
+        score += (1 << 15) + cortex_eval_piece_value(m.promote_type);
+    }
+
+    if (m.move_attr & CORTEX_MOVE_ATTR_CHECK) {
+        score += 1 << 14;
+    }
+
+    return score;
+}
+
+/*
+ * Pass the search progress to the progress callback.
+ * Only called from the main thread. Unless <force> is set, reports are dropped until the interval has passed.
+ */
+static void _cortex_eval_report(int force) {
+    if (!_cortex_eval_progress) return;
+
+    uint64_t now = cortex_clock_ms();
+    if (!force && now - _cortex_eval_report_ms < (uint64_t) _cortex_eval_progress_interval) return;
+
+    _cortex_eval_report_ms = now;
+
+    uint64_t nodes = _cortex_eval_nodes();
+    int hashfull = cortex_eval_cache_hashfull();
+
+    for (int i = 0; i < _cortex_eval_line_count; ++i) {
+        cortex_eval_info* info = _cortex_eval_lines + i;
+
+        info->nodes = nodes;
+        info->time_ms = now - _cortex_eval_start_ms;
+        info->nps = info->time_ms ? info->nodes * 1000 / info->time_ms : 0;
+        info->hashfull = hashfull;
+
+        _cortex_eval_progress(info, _cortex_eval_progress_data);
+    }
+}
+
+/* Nodes searched by all threads. Helpers count their own, an approximate sum is good enough. */
+static uint64_t _cortex_eval_nodes() {
+    uint64_t nodes = 0;
+
+    for (int i = 0; i < _cortex_eval_thread_count; ++i) {
+        nodes += __atomic_load_n(&_cortex_eval_threads[i].nodes, __ATOMIC_RELAXED);
+    }
+
+    return nodes;
+}
+
+/* Stop a time managed search once its maximum time is used up. Only called from the main thread. */
+static void _cortex_eval_check_time() {
+    if (!_cortex_eval_timed) return;
+
+    if (__atomic_load_n(&_cortex_eval_pondering, __ATOMIC_RELAXED)) {
+        _cortex_eval_time_pondered = 1;
+        return;
+    }
+
+    uint64_t now = cortex_clock_ms();
+
+    if (_cortex_eval_time_pondered) {
+        cortex_eval_time_restart(&_cortex_eval_time, now);
+        _cortex_eval_time_pondered = 0;
+    }
+
+    if (cortex_eval_time_up(&_cortex_eval_time, now)) __atomic_store_n(&_cortex_eval_stop, 1, __ATOMIC_RELAXED);
+}
+
+/* Check if a root move is one of the excluded multi-PV moves. */
+static int _cortex_eval_excluded(cortex_eval_thread* t, cortex_move m) {
+    for (int i = 0; i < t->excluded_count; ++i) {
+        cortex_move e = t->excluded[i];
+        if (e.from == m.from && e.to == m.to && e.promote_type == m.promote_type && e.move_type == m.move_type) return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Recover the principal variation by following the cached best moves from <b>, starting with <first>.
+ * Stops at a cache miss, a cached move that isn't legal (another position with the same slot) or after <max> moves.
+ */
+static int _cortex_eval_pv(cortex_board* b, cortex_move first, cortex_move* out, int max) {
+    cortex_board pos;
+    memcpy(&pos, b, sizeof pos);
+
+    cortex_move move = first;
+    int len = 0;
+
+    while (len < max) {
+        out[len++] = move;
+        cortex_board_apply_move(&pos, move);
+
+        cortex_score cached_score;
+        cortex_move cached_move;
+        int cached_depth, cached_bound, found = 0;
+
+        if (!cortex_eval_try_cache(&pos, len, &cached_score, &cached_move, &cached_depth, &cached_bound)) break;
+
+        for (int i = 0; i < pos.legal_moves.len; ++i) {
+            cortex_move m = pos.legal_moves.list[i];
+
+            if (m.from == cached_move.from && m.to == cached_move.to && m.promote_type == cached_move.promote_type) {
+                move = m;
+                found = 1;
+                break;
+            }
         }
+
+        if (!found) break;
     }
+
+    return len;
 }
 
-float cortex_eval_material(cortex_board* b, int total) {
-    float sum = 0.0f;
+static void _cortex_eval_init_tables() {
+    static int initialized = 0;
+    if (initialized) return;
 
-    for (int i = 0; i < 64; ++i) {
-        if (CORTEX_PIECE_GET_COLOR(b->state[i]) == CORTEX_PIECE_COLOR_WHITE || total) {
-            sum += cortex_eval_piece_value(b->state[i]);
-        } else {
-            sum -= cortex_eval_piece_value(b->state[i]);
+    _cortex_eval_init_lmr();
+
+    for (int d = 0; d <= CORTEX_EVAL_LMP_DEPTH; ++d) {
+        _cortex_eval_lmp_table[d] = 3 + d * d;
+    }
+
+    for (int i = 0; i < CORTEX_EVAL_MAX_THREADS; ++i) {
+        cortex_eval_split_deque_init(_cortex_eval_deques + i);
+    }
+
+    initialized = 1;
+}
+
+/* Late move reductions, from the LMR_BASE and LMR_DIVISOR parameters. */
+static void _cortex_eval_init_lmr() {
+    for (int d = 0; d <= CORTEX_EVAL_MAX_DEPTH; ++d) {
+        for (int m = 0; m < 64; ++m) {
+            _cortex_eval_lmr_table[d][m] = (d && m) ? (int) (_cortex_eval_lmr_base / 100.0 + log(d) * log(m) / (_cortex_eval_lmr_divisor / 100.0)) : 0;
         }
     }
+}
 
-    return sum;
+int cortex_eval_param_count() {
+    return CORTEX_EVAL_SEARCH_PARAMS + 2 * CORTEX_EVAL_WEIGHT_COUNT;
 }
 
-float cortex_eval_piece_value(cortex_piece p) {
-    if (!p) return 0.0f;
-    float out = 0.0f;
+int cortex_eval_param_find(const char* name) {
+    for (int i = 0; i < cortex_eval_param_count(); ++i) {
+        const char* param_name;
+        cortex_eval_param_info(i, &param_name, NULL, NULL, NULL);
 
-    switch (CORTEX_PIECE_GET_TYPE(p)) {
-    case CORTEX_PIECE_TYPE_PAWN:
-        out = 1.0f;
-        break;
-    case CORTEX_PIECE_TYPE_BISHOP:
-        out = 3.1f;
-        break;
-    case CORTEX_PIECE_TYPE_KNIGHT:
-        out = 3.0f;
-        break;
-    case CORTEX_PIECE_TYPE_QUEEN:
-        out = 6.5f;
-        break;
-    case CORTEX_PIECE_TYPE_ROOK:
-        out = 5.0f;
-        break;
+        if (!strcmp(name, param_name)) return i;
+    }
+
+    return -1;
+}
+
+int cortex_eval_param_info(int i, const char** name, int* min, int* max, int* step) {
+    if (i < 0 || i >= cortex_eval_param_count()) return -1;
+
+    const cortex_eval_param* param = _cortex_eval_params + i;
+    cortex_eval_param weight;
+
+    /* Weights perturb by a tenth of their default, so small per-square terms move in small steps. */
+    if (i >= CORTEX_EVAL_SEARCH_PARAMS) {
+        int w = (i - CORTEX_EVAL_SEARCH_PARAMS) / 2, eg = (i - CORTEX_EVAL_SEARCH_PARAMS) % 2;
+        int value = eg ? CORTEX_EVAL_PAIR_EG(_cortex_eval_weight_defaults[w]) : CORTEX_EVAL_PAIR_MG(_cortex_eval_weight_defaults[w]);
+
+        weight.name = _cortex_eval_weight_param_names[i - CORTEX_EVAL_SEARCH_PARAMS];
+        weight.min = -CORTEX_EVAL_WEIGHT_LIMIT;
+        weight.max = CORTEX_EVAL_WEIGHT_LIMIT;
+        weight.step = 2 + abs(value) / 10;
+        param = &weight;
+    }
+
+    if (name) *name = param->name;
+    if (min) *min = param->min;
+    if (max) *max = param->max;
+    if (step) *step = param->step;
+
+    return 0;
+}
+
+int cortex_eval_param_get(int i) {
+    if (i < 0 || i >= cortex_eval_param_count()) return 0;
+    if (i < CORTEX_EVAL_SEARCH_PARAMS) return *_cortex_eval_params[i].value;
+
+    int w = (i - CORTEX_EVAL_SEARCH_PARAMS) / 2;
+    return ((i - CORTEX_EVAL_SEARCH_PARAMS) % 2) ? CORTEX_EVAL_PAIR_EG(cortex_eval_weights[w]) : CORTEX_EVAL_PAIR_MG(cortex_eval_weights[w]);
+}
+
+int cortex_eval_param_set(int i, int value) {
+    int min, max;
+    if (cortex_eval_param_info(i, NULL, &min, &max, NULL)) return -1;
+
+    if (value < min) value = min;
+    if (value > max) value = max;
+
+    if (i < CORTEX_EVAL_SEARCH_PARAMS) {
+        *_cortex_eval_params[i].value = value;
+        if (_cortex_eval_params[i].value == &_cortex_eval_lmr_base || _cortex_eval_params[i].value == &_cortex_eval_lmr_divisor) _cortex_eval_init_lmr();
+
+        return 0;
+    }
+
+    int w = (i - CORTEX_EVAL_SEARCH_PARAMS) / 2;
+    cortex_eval_pair old = cortex_eval_weights[w];
+
+    if ((i - CORTEX_EVAL_SEARCH_PARAMS) % 2) {
+        cortex_eval_weights[w] = CORTEX_EVAL_PAIR(CORTEX_EVAL_PAIR_MG(old), value);
+    } else {
+        cortex_eval_weights[w] = CORTEX_EVAL_PAIR(value, CORTEX_EVAL_PAIR_EG(old));
+    }
+
+    return 0;
+}
+
+cortex_score cortex_eval_material(cortex_board* b) {
+    return b->material;
+}
+
+/* A position set up from FEN has no move history to read checks from, so the attack sets decide. */
+int cortex_eval_in_check(cortex_board* b) {
+    cortex_piece_color col = b->color_to_move;
+    if (b->king[col] == CORTEX_SQUARE_INVALID) return 0;
+
+    return (b->attacks[!col] & CORTEX_BOARD_SQUARE_BIT(b->king[col])) != 0;
+}
+
+/*
+ * Static exchange evaluation.
+ * Plays out every capture on the target square, least valuable attacker first, and returns the material
+ * the moving color wins when both sides stop capturing at their best moment.
+ */
+cortex_score cortex_eval_see(cortex_board* b, cortex_move m) {
+    cortex_score gain[32];
+    int d = 0;
+
+    /* The board is never written to: pieces that have captured are masked out of the attacker queries instead. */
+    uint64_t removed = CORTEX_BOARD_SQUARE_BIT(m.from);
+
+    cortex_piece on_square = b->state[m.from];
+    cortex_piece_color side = !CORTEX_PIECE_GET_COLOR(on_square);
+
+    gain[0] = m.is_en_passant ? cortex_eval_piece_value(CORTEX_PIECE_TYPE_PAWN) : _cortex_eval_see_value(b->state[m.to]);
+
+    if (m.is_en_passant) {
+        removed |= CORTEX_BOARD_SQUARE_BIT(b->move_history.list[b->move_history.len - 1].to);
+    }
+
+    if (m.move_attr & CORTEX_MOVE_ATTR_PROMOTE) {
+        gain[0] += cortex_eval_piece_value(m.promote_type) - cortex_eval_piece_value(CORTEX_PIECE_TYPE_PAWN);
+        on_square = m.promote_type;
+    }
+
+    /* Nothing can recapture if the other color attacks neither the target nor a line through the emptied square. */
+    if (!m.is_en_passant && !(b->attacks[side] & (CORTEX_BOARD_SQUARE_BIT(m.to) | CORTEX_BOARD_SQUARE_BIT(m.from)))) {
+        return gain[0];
+    }
+
+    while (d < 31) {
+        /* Find the least valuable attacker for the side to capture, looking through pieces that already captured. */
+        cortex_square attacker = CORTEX_SQUARE_INVALID;
+        cortex_score attacker_value = 0;
+
+        for (uint64_t set = cortex_board_get_attackers(b, m.to, removed); set; set &= set - 1) {
+            cortex_square sq = __builtin_ctzll(set);
+            if (CORTEX_PIECE_GET_COLOR(b->state[sq]) != side) continue;
+
+            cortex_score value = _cortex_eval_see_value(b->state[sq]);
+
+            if (attacker == CORTEX_SQUARE_INVALID || value < attacker_value) {
+                attacker = sq;
+                attacker_value = value;
+            }
+        }
+
+        if (attacker == CORTEX_SQUARE_INVALID) break;
+
+        ++d;
+        gain[d] = _cortex_eval_see_value(on_square) - gain[d - 1];
+
+        on_square = b->state[attacker];
+        removed |= CORTEX_BOARD_SQUARE_BIT(attacker);
+        side = !side;
+    }
+
+    /* Either side may decline to recapture. */
+    for (; d > 0; --d) {
+        if (-gain[d] < gain[d - 1]) gain[d - 1] = -gain[d];
+    }
+
+    return gain[0];
+}
+
+/* Piece value for exchanges. The king can only ever be the last piece to capture. */
+static cortex_score _cortex_eval_see_value(cortex_piece p) {
+    if (CORTEX_PIECE_GET_TYPE(p) == CORTEX_PIECE_TYPE_KING) return 10000;
+    return cortex_eval_piece_value(p);
+}
+
+cortex_score cortex_eval_piece_value(cortex_piece p) {
+    int weight = _cortex_eval_piece_weight(p);
+    return weight < 0 ? 0 : CORTEX_EVAL_PAIR_MG(cortex_eval_weights[weight]);
+}
+
+cortex_score cortex_eval_immediate(cortex_board* b) {
+    return cortex_eval_lazy(b, -CORTEX_SCORE_INFINITY, CORTEX_SCORE_INFINITY);
+}
+
+cortex_score cortex_eval_lazy(cortex_board* b, cortex_score alpha, cortex_score beta) {
+    /* The network's scores aren't on the handcrafted scale, so there is no early exit for it. */
+    if (cortex_eval_nnue_loaded()) {
+        cortex_score score = cortex_eval_nnue_evaluate(&b->nnue, b->color_to_move);
+        return (b->color_to_move == CORTEX_PIECE_COLOR_WHITE) ? score : -score;
+    }
+
+    /* Material and piece-square scores are kept by the board and cost next to nothing. */
+    cortex_score eval = cortex_eval_taper(b->phase, b->psq);
+
+    if (eval + _cortex_eval_lazy_margin <= alpha || eval - _cortex_eval_lazy_margin >= beta) {
+        return eval;
+    }
+
+    return cortex_eval_taper(b->phase, b->psq + cortex_eval_positional(b));
+}
+
+cortex_score cortex_eval_taper(int phase, cortex_eval_pair p) {
+    /* Promotions can push the phase past its starting value. */
+    if (phase > CORTEX_EVAL_PHASE_MAX) phase = CORTEX_EVAL_PHASE_MAX;
+
+    return (CORTEX_EVAL_PAIR_MG(p) * phase + CORTEX_EVAL_PAIR_EG(p) * (CORTEX_EVAL_PHASE_MAX - phase)) / CORTEX_EVAL_PHASE_MAX;
+}
+
+cortex_eval_pair cortex_eval_positional(cortex_board* b) {
+    int32_t counts[CORTEX_EVAL_WEIGHT_COUNT];
+    _cortex_eval_positional_counts(b, counts);
+
+    cortex_eval_pair out = 0;
+
+    for (int i = CORTEX_EVAL_WEIGHT_DOUBLED_PAWN; i < CORTEX_EVAL_WEIGHT_COUNT; ++i) {
+        out += counts[i] * cortex_eval_weights[i];
     }
 
     return out;
 }
 
-float cortex_eval_immediate(cortex_board* b) {
-    float eval = cortex_eval_material(b, 0);
-    float opening_factor = cortex_eval_opening_factor(b);
+/* Count the scanned weights, from DOUBLED_PAWN on. The earlier counts are left untouched. */
+static void _cortex_eval_positional_counts(cortex_board* b, int32_t* counts) {
+    cortex_eval_scan scan = { { { 0 } } };
+
+    for (int f = 0; f < 10; ++f) scan.lowest[0][f] = scan.lowest[1][f] = 9;
+
+    for (int sq = 0; sq < 64; ++sq) {
+        cortex_piece p = b->state[sq];
+        cortex_piece_color col = CORTEX_PIECE_GET_COLOR(p);
+
+        if (CORTEX_PIECE_GET_TYPE(p) == CORTEX_PIECE_TYPE_BISHOP) {
+            ++scan.bishops[col];
+        } else if (CORTEX_PIECE_GET_TYPE(p) == CORTEX_PIECE_TYPE_PAWN) {
+            int rank = CORTEX_SQUARE_RANK(sq), file = CORTEX_SQUARE_FILE(sq);
+
+            ++scan.pawns[col][file];
+            if (rank < scan.lowest[col][file]) scan.lowest[col][file] = rank;
+            if (rank > scan.highest[col][file]) scan.highest[col][file] = rank;
+        }
+    }
+
+    for (int i = CORTEX_EVAL_WEIGHT_DOUBLED_PAWN; i < CORTEX_EVAL_WEIGHT_COUNT; ++i) counts[i] = 0;
+
+    _cortex_eval_positional_side(b, &scan, CORTEX_PIECE_COLOR_WHITE, counts, 1);
+    _cortex_eval_positional_side(b, &scan, CORTEX_PIECE_COLOR_BLACK, counts, -1);
+}
+
+/* Add the scanned counts of one color times <sign>. Always inlined with a constant color, so the pawn direction is fixed. */
+static inline void _cortex_eval_positional_side(cortex_board* b, cortex_eval_scan* scan, cortex_piece_color col, int32_t* counts, int sign) {
+    if (scan->bishops[col] >= 2) counts[CORTEX_EVAL_WEIGHT_BISHOP_PAIR] += sign;
+
+    /* The attack sets were found with the legal moves. */
+    counts[CORTEX_EVAL_WEIGHT_MOBILITY] += sign * __builtin_popcountll(b->attacks[col]);
+
+    if (b->king[!col] != CORTEX_SQUARE_INVALID) {
+        uint64_t zone = cortex_board_get_attacks(b, b->king[!col]) | CORTEX_BOARD_SQUARE_BIT(b->king[!col]);
+        counts[CORTEX_EVAL_WEIGHT_KING_ATTACK] += sign * __builtin_popcountll(b->attacks[col] & zone);
+    }
+
+    for (int f = 1; f <= 8; ++f) {
+        int pawns = scan->pawns[col][f];
+        if (!pawns) continue;
+
+        if (pawns > 1) counts[CORTEX_EVAL_WEIGHT_DOUBLED_PAWN] += sign * (pawns - 1);
+        if (!scan->pawns[col][f - 1] && !scan->pawns[col][f + 1]) counts[CORTEX_EVAL_WEIGHT_ISOLATED_PAWN] += sign * pawns;
+
+        /* Only the most advanced pawn on a file can be passed. Enemy pawns ahead of it on this or a neighbouring file stop it. */
+        int front = (col == CORTEX_PIECE_COLOR_WHITE) ? scan->highest[col][f] : scan->lowest[col][f];
+        int passed = 1;
+
+        for (int g = f - 1; g <= f + 1; ++g) {
+            if (col == CORTEX_PIECE_COLOR_WHITE) {
+                passed &= scan->highest[!col][g] <= front;
+            } else {
+                passed &= scan->lowest[!col][g] >= front;
+            }
+        }
 
-    if (opening_factor > 0.0f) {
-        eval += cortex_eval_opening_factor(b) * cortex_eval_opening(b);
+        if (passed) counts[CORTEX_EVAL_WEIGHT_PASSED_PAWN] += sign * ((col == CORTEX_PIECE_COLOR_WHITE) ? front - 2 : 7 - front);
     }
+}
+
+cortex_score cortex_eval_middlegame(cortex_board* b) {
+    return CORTEX_EVAL_PAIR_MG(b->psq + cortex_eval_positional(b));
+}
+
+cortex_score cortex_eval_endgame(cortex_board* b) {
+    return CORTEX_EVAL_PAIR_EG(b->psq + cortex_eval_positional(b));
+}
 
-    return eval;
+float cortex_eval_middlegame_factor(cortex_board* b) {
+    int phase = b->phase < CORTEX_EVAL_PHASE_MAX ? b->phase : CORTEX_EVAL_PHASE_MAX;
+    return (float) phase / CORTEX_EVAL_PHASE_MAX;
 }
 
-static float _cortex_clamp(float x) {
-    if (x < 0.0f) return 0.0f;
-    if (x > 1.0f) return 1.0f;
-    return x;
+float cortex_eval_endgame_factor(cortex_board* b) {
+    return 1.0f - cortex_eval_middlegame_factor(b);
 }
 
-float cortex_eval_opening_factor(cortex_board* b) {
-    /* The opening factor is the first 20% of total material */
-    float tm = (73.5 - cortex_eval_material(b, 1)) / 73.5;
+cortex_eval_pair cortex_eval_piece_square(cortex_piece p, cortex_square sq) {
+    int weights[2], counts[2];
+    int terms = _cortex_eval_piece_terms(p, sq, weights, counts);
 
-    return _cortex_clamp(tm * 5);
+    cortex_eval_pair out = 0;
+
+    for (int i = 0; i < terms; ++i) {
+        out += counts[i] * cortex_eval_weights[weights[i]];
+    }
+
+    return (CORTEX_PIECE_GET_COLOR(p) != CORTEX_PIECE_COLOR_WHITE) ? -out : out;
+}
+
+void cortex_eval_features(cortex_board* b, int32_t counts[CORTEX_EVAL_WEIGHT_COUNT]) {
+    for (int i = 0; i < CORTEX_EVAL_WEIGHT_DOUBLED_PAWN; ++i) counts[i] = 0;
+
+    for (int sq = 0; sq < 64; ++sq) {
+        cortex_piece p = b->state[sq];
+
+        int weights[2], piece_counts[2];
+        int terms = _cortex_eval_piece_terms(p, sq, weights, piece_counts);
+        int sign = (CORTEX_PIECE_GET_COLOR(p) != CORTEX_PIECE_COLOR_WHITE) ? -1 : 1;
+
+        for (int i = 0; i < terms; ++i) {
+            counts[weights[i]] += sign * piece_counts[i];
+        }
+    }
+
+    _cortex_eval_positional_counts(b, counts);
 }
 
-float cortex_eval_opening(cortex_board* p) {
-    /* Enjoy developing minor pieces. */
-    float eval = 0.0f;
-    eval += cortex_eval_developed_pieces(p);
+/* The weight of a piece's value, or -1 for kings and empty squares. */
+static int _cortex_eval_piece_weight(cortex_piece p) {
+    if (!p) return -1;
+
+    switch (CORTEX_PIECE_GET_TYPE(p)) {
+    case CORTEX_PIECE_TYPE_PAWN:
+        return CORTEX_EVAL_WEIGHT_PAWN;
+    case CORTEX_PIECE_TYPE_KNIGHT:
+        return CORTEX_EVAL_WEIGHT_KNIGHT;
+    case CORTEX_PIECE_TYPE_BISHOP:
+        return CORTEX_EVAL_WEIGHT_BISHOP;
+    case CORTEX_PIECE_TYPE_ROOK:
+        return CORTEX_EVAL_WEIGHT_ROOK;
+    case CORTEX_PIECE_TYPE_QUEEN:
+        return CORTEX_EVAL_WEIGHT_QUEEN;
+    }
 
-    return eval;
+    return -1;
 }
 
-/* Judge how well pieces are developed for each color. */
-float cortex_eval_developed_pieces(cortex_board* p) {
-    float eval = 0.0f;
+/*
+ * The per-piece weights a piece on a square counts toward, from its own color's side: fills up to two
+ * weights and their counts, and returns how many.
+ */
+static int _cortex_eval_piece_terms(cortex_piece p, cortex_square sq, int* weights, int* counts) {
+    if (!p) return 0;
 
-    for (int i = 0; i < 64; ++i) {
-        cortex_piece cur = p->state[i];
-        cortex_piece_color col = CORTEX_PIECE_GET_COLOR(cur);
+    int terms = 0, value = _cortex_eval_piece_weight(p);
 
-        if (!CORTEX_PIECE_IS_MINOR(cur)) continue;
+    if (value >= 0) {
+        weights[terms] = value;
+        counts[terms++] = 1;
+    }
 
-        int rank = CORTEX_SQUARE_RANK(i);
+    /* Ranks and files counted from white's side, 1 to 8. */
+    int rank = CORTEX_SQUARE_RANK(sq), file = CORTEX_SQUARE_FILE(sq);
+    if (CORTEX_PIECE_GET_COLOR(p) != CORTEX_PIECE_COLOR_WHITE) rank = 9 - rank;
 
-        /* White would like to develop to the third and fourth ranks. Black wants the 6th and 5th. */
-        if (col == CORTEX_PIECE_COLOR_WHITE && (rank == 3 || rank == 4)) {
-            eval += CORTEX_EVAL_DEVELOPMENT;
-        } else if (col == CORTEX_PIECE_COLOR_BLACK && (rank == 6 || rank == 5)) {
-            eval -= CORTEX_EVAL_DEVELOPMENT;
+    if (CORTEX_PIECE_IS_MINOR(p)) {
+        /* Develop to the third and fourth ranks. */
+        if (rank == 3 || rank == 4) {
+            weights[terms] = CORTEX_EVAL_WEIGHT_DEVELOPMENT;
+            counts[terms++] = 1;
         }
+    } else if (CORTEX_PIECE_GET_TYPE(p) == CORTEX_PIECE_TYPE_PAWN) {
+        weights[terms] = CORTEX_EVAL_WEIGHT_PAWN_ADVANCE;
+        counts[terms++] = rank - 2;
+    } else if (CORTEX_PIECE_GET_TYPE(p) == CORTEX_PIECE_TYPE_KING) {
+        /* Steps from the four center squares. */
+        int rank_dist = rank <= 4 ? 4 - rank : rank - 5;
+        int file_dist = file <= 4 ? 4 - file : file - 5;
+
+        weights[terms] = CORTEX_EVAL_WEIGHT_KING_CENTER;
+        counts[terms++] = 3 - (rank_dist > file_dist ? rank_dist : file_dist);
+    }
+
+    return terms;
+}
+
+int cortex_eval_piece_phase(cortex_piece p) {
+    switch (CORTEX_PIECE_GET_TYPE(p)) {
+    case CORTEX_PIECE_TYPE_KNIGHT:
+    case CORTEX_PIECE_TYPE_BISHOP:
+        return 1;
+    case CORTEX_PIECE_TYPE_ROOK:
+        return 2;
+    case CORTEX_PIECE_TYPE_QUEEN:
+        return 4;
     }
 
-    return eval;
+    return 0;
 }
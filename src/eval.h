@@ -2,52 +2,340 @@
 
 #include "move.h"
 #include "board.h"
+#include "eval_weights.h"
+
+#include <stddef.h>
 
 #define CORTEX_EVAL_DEPTH 4
+#define CORTEX_EVAL_MAX_DEPTH 64
+#define CORTEX_EVAL_MAX_PLY 128
+#define CORTEX_EVAL_MAX_THREADS 64
+#define CORTEX_EVAL_MAX_MULTIPV 32
+
+/*
+ * Scores are integer centipawns relative to the color to move.
+ * Mates are scored MATE - plies to mate, being mated -(MATE - plies to mate), so a faster mate
+ * is always a higher score and any two scores compare with a plain >.
+ */
+typedef int32_t cortex_score;
+
+#define CORTEX_SCORE_MATE 32000
+#define CORTEX_SCORE_INFINITY 32001
+#define CORTEX_SCORE_MATE_BOUND (CORTEX_SCORE_MATE - CORTEX_EVAL_MAX_PLY)
+
+/*
+ * A midgame and an endgame score packed into one integer, so both are summed with a single addition.
+ * The endgame half is stored in the upper 16 bits, and a negative midgame half borrows from it.
+ */
+typedef int32_t cortex_eval_pair;
+
+#define CORTEX_EVAL_PAIR(mg, eg) ((cortex_eval_pair) ((uint32_t) (eg) << 16) + (mg))
+#define CORTEX_EVAL_PAIR_MG(p) ((cortex_score) (int16_t) (uint16_t) (uint32_t) (p))
+#define CORTEX_EVAL_PAIR_EG(p) ((cortex_score) (int16_t) (uint16_t) (((uint32_t) (p) + 0x8000) >> 16))
+
+#define CORTEX_SCORE_IS_MATE(s) ((s) >= CORTEX_SCORE_MATE_BOUND || (s) <= -CORTEX_SCORE_MATE_BOUND)
+
+/* Full moves to mate. Positive if the color to move delivers it. */
+#define CORTEX_SCORE_MATE_IN(s) ((s) > 0 ? (CORTEX_SCORE_MATE - (s) + 1) / 2 : -(CORTEX_SCORE_MATE + (s)) / 2)
+
+/* Parallel search modes. */
+#define CORTEX_EVAL_SMP_LAZY 0 /* every thread searches the whole tree, sharing the cache */
+#define CORTEX_EVAL_SMP_YBWC 1 /* threads steal sibling moves from split points (young brothers wait) */
+
+/* Search algorithms. */
+#define CORTEX_EVAL_ENGINE_ALPHABETA 0 /* iterative deepening alpha-beta */
+#define CORTEX_EVAL_ENGINE_MCTS      1 /* Monte Carlo tree search over the static evaluation */
+
+/* Root search drivers. */
+#define CORTEX_EVAL_DRIVER_ASPIRATION 0 /* windows around the previous iteration's score, widened on failure */
+#define CORTEX_EVAL_DRIVER_MTDF       1 /* repeated null-window searches converging on the score (MTD(f)) */
+
+/*
+ * Aspiration windows. From ASPIRATION_DEPTH on, each iteration is first searched ASPIRATION_WINDOW centipawns
+ * either side of the previous score, and the failing side is widened by twice as much each time.
+ */
+#define CORTEX_EVAL_ASPIRATION_DEPTH 4
+#define CORTEX_EVAL_ASPIRATION_WINDOW 30
+
+/* Minimum remaining depth for a node to be split between threads. */
+#define CORTEX_EVAL_SPLIT_DEPTH 3
+
+struct _cortex_eval_split;
+
+/* Per-thread search state. */
+typedef struct _cortex_eval_thread {
+    int id;
+    struct _cortex_eval_split* split; /* split point of the task being worked on, if any */
+    cortex_board root; /* private copy of the position being searched */
+    cortex_move root_move; /* best root move of the iteration in progress */
+    cortex_move best_move; /* best root move of the last completed iteration */
+    cortex_score score;
+    int depth; /* last completed depth */
+    uint64_t nodes;
+    cortex_move excluded[CORTEX_EVAL_MAX_MULTIPV]; /* root moves left out of the search (multi-PV) */
+    int excluded_count;
+} cortex_eval_thread;
+
+/* Search progress, as passed to the progress callback. Scores are relative to the color to move at the root. */
+typedef struct _cortex_eval_info {
+    int multipv; /* line number, 1 for the best line */
+    int depth; /* last completed depth */
+    cortex_score score;
+    uint64_t nodes; /* summed over all threads */
+    uint64_t nps;
+    uint64_t time_ms; /* since the search started */
+    int hashfull; /* cache usage in permille */
+    int pv_len;
+    cortex_move pv[CORTEX_EVAL_MAX_DEPTH];
+} cortex_eval_info;
+
+typedef void (*cortex_eval_progress_callback)(const cortex_eval_info* info, void* data);
+
+/*
+ * Late move reductions.
+ * Quiet moves from the LMR_MOVES'th onwards at LMR_DEPTH and deeper are searched with a reduced depth of
+ * LMR_BASE + ln(depth) * ln(move number) / LMR_DIVISOR.
+ */
+#define CORTEX_EVAL_LMR_DEPTH 3
+#define CORTEX_EVAL_LMR_MOVES 3
+#define CORTEX_EVAL_LMR_BASE 0.75
+#define CORTEX_EVAL_LMR_DIVISOR 2.25
+
+/*
+ * Frontier pruning margins, in centipawns per remaining ply. Applied at FRONTIER_DEPTH and shallower.
+ * Override at build time (-DCORTEX_EVAL_FUTILITY_MARGIN=...) to tune them.
+ *   FUTILITY_MARGIN: quiet moves are skipped if the static eval plus this can't reach alpha.
+ *   REVERSE_FUTILITY_MARGIN: the node fails high if the static eval minus this still beats beta.
+ *   RAZOR_MARGIN: the node drops into quiescence if the static eval plus this can't reach alpha.
+ */
+#define CORTEX_EVAL_FRONTIER_DEPTH 3
+
+#ifndef CORTEX_EVAL_FUTILITY_MARGIN
+#define CORTEX_EVAL_FUTILITY_MARGIN 125
+#endif
+
+#ifndef CORTEX_EVAL_REVERSE_FUTILITY_MARGIN
+#define CORTEX_EVAL_REVERSE_FUTILITY_MARGIN 100
+#endif
+
+#ifndef CORTEX_EVAL_RAZOR_MARGIN
+#define CORTEX_EVAL_RAZOR_MARGIN 250
+#endif
 
 /*
- * Generic importance for phase-specific evaluations.
- * Scales all evaluation bonuses for the respective stage.
+ * ProbCut. At PROBCUT_DEPTH and deeper in non-PV nodes, captures winning enough material are searched
+ * PROBCUT_REDUCTION plies shallower against beta + PROBCUT_MARGIN, and the node is cut if one beats it.
+ * Every root move is searched with the full window, so the deepest non-PV nodes are two plies below the
+ * iteration depth. PROBCUT_DEPTH is kept there so the default search reaches it, and the reduced search
+ * drops straight into quiescence.
  */
-#define CORTEX_EVAL_OPENING_SCALE 1.0f
-#define CORTEX_EVAL_MIDDLEGAME_SCALE 1.0f
-#define CORTEX_EVAL_ENDGAME_SCALE 1.0f
+#define CORTEX_EVAL_PROBCUT_DEPTH 2
+#define CORTEX_EVAL_PROBCUT_REDUCTION 2
+#define CORTEX_EVAL_PROBCUT_MARGIN 200
 
-#define CORTEX_EVAL_DEVELOPMENT 1.5f
+/* Move-count pruning. At LMP_DEPTH and shallower, only the first 3 + depth^2 moves are searched. */
+#define CORTEX_EVAL_LMP_DEPTH 3
 
-typedef struct _cortex_eval {
-    float evaluation;
-    int found_mate;
-    int mate_in;
-    int game_over;
-    cortex_move best_move;
-} cortex_eval;
+/*
+ * Game phase, counted from the pieces left: 1 per minor piece, 2 per rook and 4 per queen.
+ * The static evaluation blends the midgame and endgame scores by phase / PHASE_MAX.
+ */
+#define CORTEX_EVAL_PHASE_MAX 24
+
+/*
+ * Evaluation weights, each a midgame/endgame pair, with their defaults in eval_weights.h:
+ *   PAWN .. QUEEN  piece values
+ *   DEVELOPMENT    per minor piece on its third or fourth rank
+ *   PAWN_ADVANCE   per rank a pawn has advanced
+ *   KING_CENTER    per step the king is closer to the center
+ *   DOUBLED_PAWN   per pawn behind another of its color
+ *   ISOLATED_PAWN  per pawn with no pawns of its color on the neighbouring files
+ *   PASSED_PAWN    per rank advanced, no enemy pawns ahead on its own or neighbouring files
+ *   BISHOP_PAIR
+ *   MOBILITY       per square attacked
+ *   KING_ATTACK    per square around the enemy king attacked
+ * Weights from DOUBLED_PAWN on are found by scanning the board, the others are kept by the board per piece.
+ */
+#define CORTEX_EVAL_WEIGHT_ENUM(name, mg, eg) CORTEX_EVAL_WEIGHT_##name,
+
+enum {
+    CORTEX_EVAL_WEIGHTS(CORTEX_EVAL_WEIGHT_ENUM)
+    CORTEX_EVAL_WEIGHT_COUNT
+};
+
+/* Current weights. Boards set up before a change keep stale scores until cortex_board_update_scores(). */
+extern cortex_eval_pair cortex_eval_weights[CORTEX_EVAL_WEIGHT_COUNT];
+extern const char* cortex_eval_weight_names[CORTEX_EVAL_WEIGHT_COUNT];
+
+/* Weights are kept within +-WEIGHT_LIMIT, so the sums of a position stay inside the halves of a pair. */
+#define CORTEX_EVAL_WEIGHT_LIMIT 8000
+
+/*
+ * Lazy evaluation. If material and piece-square scores alone are more than LAZY_MARGIN outside the
+ * window, the scanned terms are skipped. They are not bounded by the margin (passed pawns, king attacks
+ * and mobility can swing further), so a lazy score is an estimate that can even land on the wrong side.
+ * Only the handcrafted evaluation is lazy. A loaded network is always evaluated in full.
+ */
+#ifndef CORTEX_EVAL_LAZY_MARGIN
+#define CORTEX_EVAL_LAZY_MARGIN 200
+#endif
 
 /*
  * Cortex evaluation function.
  * Evaluates a position synchronously to the full depth and computes the best move for
- * the color to move.
+ * the color to move. Puts the score for the color to move in *score if given.
+ * Returns -1 if the search can't be started, leaving *best_move and *score alone.
  */
-cortex_eval cortex_eval_position(cortex_board* b);
+int cortex_eval_position(cortex_board* b, cortex_move* best_move, cortex_score* score);
+
+/*
+ * Start searching a position on the search thread and return immediately.
+ * If <ponder> is set the search has no depth limit and keeps going until cortex_eval_ponderhit() or cortex_eval_stop().
+ * A time managed search starts its clock at the ponderhit.
+ * Returns -1 if a search is already running.
+ */
+int cortex_eval_start(cortex_board* b, int ponder);
+
+/* Stop the running search. Every node checks for it, so the search unwinds within a node of each thread. */
+void cortex_eval_stop();
 
-float cortex_eval_opening(cortex_board* b);
-float cortex_eval_middlegame(cortex_board* b);
-float cortex_eval_endgame(cortex_board* b);
+/* The pondered move was played. The search carries on as a normal search, finishing at the full depth. */
+void cortex_eval_ponderhit();
 
-/* Get the factor opinions of what stage the game is in. */
-float cortex_eval_opening_factor(cortex_board* b);
+/* Wait for the running search to finish and get its best move and score. Returns 0 with *best_move untouched if none is running. */
+cortex_score cortex_eval_wait(cortex_move* best_move);
+
+/*
+ * Search only for a forced mate by the color to move in at most <moves> moves.
+ * Much cheaper than a full search for puzzle checking. Runs synchronously on the calling thread and
+ * doesn't touch the search cache, so several positions can be solved at once.
+ * Returns the number of moves to the shortest mate and fills *best_move with its first move,
+ * 0 if there is no mate within <moves>, or -1 on error.
+ */
+int cortex_eval_mate(cortex_board* b, int moves, cortex_move* best_move);
+
+/* Proof-number search results. */
+#define CORTEX_EVAL_PN_UNKNOWN   0
+#define CORTEX_EVAL_PN_PROVEN    1 /* the color to move forces mate */
+#define CORTEX_EVAL_PN_DISPROVEN 2 /* the color to move can't force mate */
+
+/*
+ * Prove or disprove a forced mate by the color to move with a proof-number search.
+ * Reaches mates far too long for cortex_eval_mate(), at the cost of up to <memory> bytes of search tree.
+ * The search gives up with CORTEX_EVAL_PN_UNKNOWN once the tree fills the memory, and also reports it instead of
+ * a disproof if any line reached CORTEX_EVAL_MAX_PLY.
+ * If <line> is given it receives up to CORTEX_EVAL_MAX_PLY moves of the main line (the proof, the refutation,
+ * or the most promising line if unknown) and *line_len its length.
+ * Returns a CORTEX_EVAL_PN_* result, or -1 on error.
+ */
+int cortex_eval_pn(cortex_board* b, size_t memory, cortex_move* line, int* line_len);
+
+/*
+ * Set the number of threads searching each position (Lazy SMP).
+ * Helper threads search the same root with slightly different depths and share results through the cache.
+ */
+void cortex_eval_set_threads(int threads);
+
+/*
+ * Named parameters, for tuning at runtime. First the search constants DEPTH, ASPIRATION_WINDOW, FUTILITY_MARGIN,
+ * REVERSE_FUTILITY_MARGIN, RAZOR_MARGIN, PROBCUT_MARGIN, LAZY_MARGIN, and LMR_BASE and LMR_DIVISOR in hundredths,
+ * starting from the defines of the same names. Then the midgame and endgame half of each evaluation weight,
+ * as PAWN_MG, PAWN_EG and so on. Parameters must not be changed while a search is running.
+ */
+int cortex_eval_param_count();
+
+/* Find a parameter by name. Returns its index, or -1 if there is none. */
+int cortex_eval_param_find(const char* name);
+
+/* Get the name, range and typical tuning step of a parameter. Any of the outputs may be NULL. Returns -1 on a bad index. */
+int cortex_eval_param_info(int i, const char** name, int* min, int* max, int* step);
+
+int cortex_eval_param_get(int i);
+
+/* Set a parameter, clamped to its range. Returns -1 on a bad index. */
+int cortex_eval_param_set(int i, int value);
+
+/* Select how threads share the search. (CORTEX_EVAL_SMP_*) */
+void cortex_eval_set_smp_mode(int mode);
+
+/*
+ * Give the following searches a clock: the time left in milliseconds, the increment per move and the number
+ * of moves to the next time control (0 if unknown). Each search then decides its own time and depth.
+ * With <time_ms> 0, the default, searches go to CORTEX_EVAL_DEPTH.
+ */
+void cortex_eval_set_clock(int time_ms, int inc_ms, int moves_to_go);
+
+/* Select how each iteration searches the root. (CORTEX_EVAL_DRIVER_*) */
+void cortex_eval_set_driver(int driver);
+
+/*
+ * Select the search algorithm. (CORTEX_EVAL_ENGINE_*)
+ * MCTS runs all threads on one shared tree and ignores the SMP mode and multi-PV.
+ */
+void cortex_eval_set_engine(int engine);
+
+/*
+ * Set the number of best lines to search (multi-PV).
+ * Each iteration searches the root again with the moves of the lines already found left out, and reports
+ * every line in order. The searches share the cache, so the extra lines cost much less than separate searches.
+ */
+void cortex_eval_set_multipv(int lines);
+
+/*
+ * Set a function to receive the search progress. The search itself does no I/O.
+ * <cb> is called on the search thread when an iteration completes, and in between no more than every <interval_ms>.
+ * Each report calls <cb> once per multi-PV line.
+ * Pass NULL to stop reporting.
+ */
+void cortex_eval_set_progress(cortex_eval_progress_callback cb, void* data, int interval_ms);
+
+/* Get the midgame and endgame halves of the static evaluation. (white-black) */
+cortex_score cortex_eval_middlegame(cortex_board* b);
+cortex_score cortex_eval_endgame(cortex_board* b);
+
+/* Get the weights of the midgame and endgame scores in the current position. They sum to 1. */
 float cortex_eval_middlegame_factor(cortex_board* b);
 float cortex_eval_endgame_factor(cortex_board* b);
 
-float cortex_eval_immediate(cortex_board* b);
+/*
+ * Static evaluation, tapered between the midgame and endgame scores by the game phase. (white-black)
+ * Uses the neural network instead while one is loaded.
+ */
+cortex_score cortex_eval_immediate(cortex_board* b);
+
+/*
+ * Static evaluation that may stop early if the score is far outside [alpha, beta]. (white-black)
+ * A score returned early is only an estimate, see CORTEX_EVAL_LAZY_MARGIN. Callers may steer pruning by it,
+ * but should not return it as a search score. Never stops early while a network is loaded.
+ */
+cortex_score cortex_eval_lazy(cortex_board* b, cortex_score alpha, cortex_score beta);
+
+/* Get the terms found by scanning the board: pawn structure, the bishop pair, mobility and king attacks. (white-black) */
+cortex_eval_pair cortex_eval_positional(cortex_board* b);
+
+/* Blend a midgame/endgame pair by a game phase. */
+cortex_score cortex_eval_taper(int phase, cortex_eval_pair p);
 
 /* Get current material difference. (white-black) */
-float cortex_eval_material(cortex_board* b, int total);
+cortex_score cortex_eval_material(cortex_board* b);
+
+/* Get the midgame value of a piece, as used by exchanges and move ordering. */
+cortex_score cortex_eval_piece_value(cortex_piece p);
+
+/* Get the midgame and endgame worth of a piece standing on a square, including its value. (white-black) */
+cortex_eval_pair cortex_eval_piece_square(cortex_piece p, cortex_square sq);
+
+/*
+ * Count how often each weight applies in a position, so the static evaluation is the phase taper of the
+ * sum of counts[i] * cortex_eval_weights[i]. Needs the attack sets. (white-black)
+ */
+void cortex_eval_features(cortex_board* b, int32_t counts[CORTEX_EVAL_WEIGHT_COUNT]);
 
-/* Get value of a piece. Always positive. */
-float cortex_eval_piece_value(cortex_piece p);
+/* Get how much a piece counts toward the game phase. */
+int cortex_eval_piece_phase(cortex_piece p);
 
-float cortex_eval_developed_pieces(cortex_board* b);
+/* Get the material won by the moving color if all captures on the target square are played out. */
+cortex_score cortex_eval_see(cortex_board* b, cortex_move m);
 
-/* Returns nonzero if the candidate is a better evalation for <col> than the current best. */
-int cortex_eval_compare(cortex_eval current_best, cortex_eval candidate_best, cortex_piece_color col);
+/* Check if the color to move is in check. Uses the attack sets, so it needs the legal moves generated. */
+int cortex_eval_in_check(cortex_board* b);
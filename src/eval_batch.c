@@ -0,0 +1,143 @@
+#include "eval_batch.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Piece-square and phase tables indexed by the raw piece byte, so the column loops don't branch. */
+typedef struct _cortex_eval_batch_tables {
+    cortex_eval_pair psq[64][256];
+    u8 phase[256];
+} cortex_eval_batch_tables;
+
+typedef struct _cortex_eval_batch_job {
+    cortex_eval_batch* batch;
+    const cortex_eval_batch_tables* tables;
+    size_t begin, end;
+} cortex_eval_batch_job;
+
+static void* _cortex_eval_batch_main(void* arg);
+
+int cortex_eval_batch_init(cortex_eval_batch* batch, size_t count) {
+    if (!batch || !count) return -1;
+
+    /* One allocation: the 64 square columns, then the scores. */
+    cortex_piece* columns = calloc(1, 64 * count + count * sizeof *batch->scores);
+    if (!columns) return -1;
+
+    for (int s = 0; s < 64; ++s) {
+        batch->squares[s] = columns + s * count;
+    }
+
+    batch->scores = (cortex_score*) (columns + 64 * count);
+    batch->count = count;
+
+    return 0;
+}
+
+void cortex_eval_batch_free(cortex_eval_batch* batch) {
+    free(batch->squares[0]);
+    memset(batch, 0, sizeof *batch);
+}
+
+void cortex_eval_batch_set(cortex_eval_batch* batch, size_t i, cortex_board* b) {
+    for (int s = 0; s < 64; ++s) {
+        batch->squares[s][i] = b->state[s];
+    }
+}
+
+int cortex_eval_batch_run(cortex_eval_batch* batch, int threads) {
+    if (!batch) return -1;
+
+    /* Built per run, so changes to the evaluation parameters are picked up. */
+    cortex_eval_batch_tables* tables = malloc(sizeof *tables);
+    if (!tables) return -1;
+
+    for (int p = 0; p < 256; ++p) {
+        int type = CORTEX_PIECE_GET_TYPE(p);
+        int valid = type >= CORTEX_PIECE_TYPE_PAWN && type <= CORTEX_PIECE_TYPE_KNIGHT && !(p & 0x70);
+
+        tables->phase[p] = valid ? cortex_eval_piece_phase(p) : 0;
+
+        for (int s = 0; s < 64; ++s) {
+            tables->psq[s][p] = valid ? cortex_eval_piece_square(p, s) : 0;
+        }
+    }
+
+    if (threads < 1) threads = 1;
+    if (threads > CORTEX_EVAL_MAX_THREADS) threads = CORTEX_EVAL_MAX_THREADS;
+
+    pthread_t handles[CORTEX_EVAL_MAX_THREADS];
+    cortex_eval_batch_job jobs[CORTEX_EVAL_MAX_THREADS];
+    int started[CORTEX_EVAL_MAX_THREADS];
+
+    /* Whole blocks per thread. */
+    size_t blocks = (batch->count + CORTEX_EVAL_BATCH_BLOCK - 1) / CORTEX_EVAL_BATCH_BLOCK;
+    size_t per_thread = (blocks + threads - 1) / threads * CORTEX_EVAL_BATCH_BLOCK;
+
+    for (int i = 0; i < threads; ++i) {
+        jobs[i].batch = batch;
+        jobs[i].tables = tables;
+        jobs[i].begin = i * per_thread;
+        jobs[i].end = jobs[i].begin + per_thread;
+
+        if (jobs[i].begin > batch->count) jobs[i].begin = batch->count;
+        if (jobs[i].end > batch->count) jobs[i].end = batch->count;
+
+        /* The calling thread takes the first share, and any a thread couldn't be started for. */
+        started[i] = i && !pthread_create(handles + i, NULL, _cortex_eval_batch_main, jobs + i);
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        if (!started[i]) _cortex_eval_batch_main(jobs + i);
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        if (started[i]) pthread_join(handles[i], NULL);
+    }
+
+    free(tables);
+    return 0;
+}
+
+static void* _cortex_eval_batch_main(void* arg) {
+    cortex_eval_batch_job* job = arg;
+    cortex_eval_batch* batch = job->batch;
+
+    cortex_eval_pair sums[CORTEX_EVAL_BATCH_BLOCK];
+    int32_t phases[CORTEX_EVAL_BATCH_BLOCK];
+
+    /* Only the state and attack sets of the scratch board are used. */
+    cortex_board scratch;
+
+    for (size_t base = job->begin; base < job->end; base += CORTEX_EVAL_BATCH_BLOCK) {
+        size_t len = job->end - base;
+        if (len > CORTEX_EVAL_BATCH_BLOCK) len = CORTEX_EVAL_BATCH_BLOCK;
+
+        memset(sums, 0, sizeof sums);
+        memset(phases, 0, sizeof phases);
+
+        /* Material, piece-square scores and phase: one pass down each square's column. */
+        for (int s = 0; s < 64; ++s) {
+            const cortex_piece* column = batch->squares[s] + base;
+            const cortex_eval_pair* psq = job->tables->psq[s];
+
+            for (size_t i = 0; i < len; ++i) {
+                sums[i] += psq[column[i]];
+                phases[i] += job->tables->phase[column[i]];
+            }
+        }
+
+        /* The scanned terms need each position as a board. */
+        for (size_t i = 0; i < len; ++i) {
+            for (int s = 0; s < 64; ++s) {
+                scratch.state[s] = batch->squares[s][base + i];
+            }
+
+            cortex_board_update_attacks(&scratch);
+            batch->scores[base + i] = cortex_eval_taper(phases[i], sums[i] + cortex_eval_positional(&scratch));
+        }
+    }
+
+    return NULL;
+}
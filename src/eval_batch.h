@@ -0,0 +1,30 @@
+#pragma once
+
+/*
+ * Batch static evaluation.
+ * Evaluates many independent positions at once, for labeling and tuning. Positions are stored as a
+ * structure of arrays, one array per square across all positions, so the material and piece-square
+ * sums run down contiguous columns the compiler can vectorize. The positions are split over threads.
+ * Always uses the handcrafted evaluation, never the network.
+ */
+
+#include "eval.h"
+
+/* Positions are evaluated in blocks of this many. A block's 64 columns should fit in the L1 cache. */
+#define CORTEX_EVAL_BATCH_BLOCK 256
+
+typedef struct _cortex_eval_batch {
+    size_t count;
+    cortex_piece* squares[64]; /* squares[s][i] is the piece on square s in position i */
+    cortex_score* scores; /* results, white-black */
+} cortex_eval_batch;
+
+/* Allocate a batch of <count> empty positions. Returns -1 on error. */
+int cortex_eval_batch_init(cortex_eval_batch* batch, size_t count);
+void cortex_eval_batch_free(cortex_eval_batch* batch);
+
+/* Store the piece placement of a board as position <i>. */
+void cortex_eval_batch_set(cortex_eval_batch* batch, size_t i, cortex_board* b);
+
+/* Evaluate every position on up to <threads> threads. Gives the same scores as cortex_eval_immediate(). Returns -1 on error. */
+int cortex_eval_batch_run(cortex_eval_batch* batch, int threads);
@@ -1,45 +1,66 @@
 #include "eval_cache.h"
-#include "xxhash.h"
-#include "log.h"
 
 #include <string.h>
 
 static cortex_eval_cache_entry _cortex_eval_cache[CORTEX_EVAL_CACHE_SIZE];
 
-static cortex_eval_cache_entry* _cortex_eval_cache_get_dst(cortex_board* b);
+int cortex_eval_try_cache(cortex_board* b, int ply, cortex_score* out, cortex_move* out_move, int *out_depth, int* out_bound) {
+    uint64_t key = cortex_eval_cache_key(b);
+    cortex_eval_cache_entry* dst = _cortex_eval_cache + (key & (CORTEX_EVAL_CACHE_SIZE - 1));
 
-int cortex_eval_try_cache(cortex_board* b, cortex_eval* out, int *out_depth) {
-    cortex_eval_cache_entry* dst = _cortex_eval_cache_get_dst(b);
+    /* Other threads may be writing the entry, read each half once. */
+    uint64_t entry_key = __atomic_load_n(&dst->key, __ATOMIC_RELAXED);
+    uint64_t data = __atomic_load_n(&dst->data, __ATOMIC_RELAXED);
 
-    if (!dst->game.len) return 0; /* don't cache empty games */
+    if ((entry_key ^ data) != key) return 0;
 
-    if (cortex_move_list_equals(&b->move_history, &dst->game)) {
-        *out = dst->eval;
-        *out_depth = dst->depth;
+    *out = (int16_t) (data & 0xFFFF);
+    *out_depth = (data >> 16) & 0xFF;
+    *out_bound = (data >> 24) & 0x3;
 
-        cortex_log_debug("cache hit on game of length %d, eval %f", dst->game.len, dst->eval.evaluation);
-        return 1;
-    }
+    out_move->from = (data >> 32) & 0xFF;
+    out_move->to = (data >> 40) & 0xFF;
+    out_move->promote_type = (data >> 48) & 0xFF;
+
+    if (*out >= CORTEX_SCORE_MATE_BOUND) *out -= ply;
+    if (*out <= -CORTEX_SCORE_MATE_BOUND) *out += ply;
+
+    return 1;
+}
 
-    return 0;
+uint64_t cortex_eval_cache_key(cortex_board* b) {
+    /* Positions are cached by their zobrist key, so transpositions share an entry. */
+    return b->key;
 }
 
-cortex_eval_cache_entry* _cortex_eval_cache_get_dst(cortex_board* b) {
-    //cortex_log_debug("grabbing dst for game:");
-    //cortex_move_list_print(&b->move_history);
+void cortex_eval_cache_insert(cortex_board* b, int ply, cortex_score score, cortex_move best_move, int depth, int bound) {
+    uint64_t key = cortex_eval_cache_key(b);
+    cortex_eval_cache_entry* dst = _cortex_eval_cache + (key & (CORTEX_EVAL_CACHE_SIZE - 1));
 
-    /* The cache is based on the moves made in the game. */
-    int index = XXH32(b->move_history.list, b->move_history.len * sizeof b->move_history.list[0], 0) % CORTEX_EVAL_CACHE_SIZE;
+    if (score >= CORTEX_SCORE_MATE_BOUND) score += ply;
+    if (score <= -CORTEX_SCORE_MATE_BOUND) score -= ply;
 
-    //cortex_log_debug("index is %d", index);
+    uint64_t data = (uint64_t) (uint16_t) score;
+    data |= (uint64_t) (depth & 0xFF) << 16;
+    data |= (uint64_t) (bound & 0x3) << 24;
+    data |= (uint64_t) best_move.from << 32;
+    data |= (uint64_t) best_move.to << 40;
+    data |= (uint64_t) best_move.promote_type << 48;
 
-    return _cortex_eval_cache + index;
+    __atomic_store_n(&dst->key, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&dst->data, data, __ATOMIC_RELAXED);
 }
 
-void cortex_eval_cache_insert(cortex_board* b, cortex_eval eval, int depth) {
-    cortex_eval_cache_entry* dst = _cortex_eval_cache_get_dst(b);
+void cortex_eval_cache_clear() {
+    memset(_cortex_eval_cache, 0, sizeof _cortex_eval_cache);
+}
+
+int cortex_eval_cache_hashfull() {
+    int used = 0;
+
+    for (int i = 0; i < 1000; ++i) {
+        if (__atomic_load_n(&_cortex_eval_cache[i].data, __ATOMIC_RELAXED)) ++used;
+    }
 
-    memcpy(&dst->game, &b->move_history, sizeof dst->game);
-    dst->eval = eval;
-    dst->depth = depth;
+    return used;
 }
@@ -2,21 +2,39 @@
 
 /*
  * Evaluation cache
- * The evaluation cache resides in static memory.
- * If multithreading is implemented in the future the code will need to be modified.
+ * The evaluation cache resides in static memory and is shared by all search threads without locks.
+ * Each entry stores its key xored with its data, so an entry torn by two threads writing at once
+ * fails the key check and reads as a miss.
  */
 
 #include "eval.h"
 
-#define CORTEX_EVAL_CACHE_SIZE 1024
+#define CORTEX_EVAL_CACHE_SIZE (1 << 20) /* must be a power of two */
+
+/* How a cached evaluation relates to the true value of the position. */
+#define CORTEX_EVAL_CACHE_EXACT 0
+#define CORTEX_EVAL_CACHE_LOWER 1 /* failed high, the true value is at least this good for the color to move */
+#define CORTEX_EVAL_CACHE_UPPER 2 /* failed low, the true value is at most this good for the color to move */
 
 typedef struct _cortex_eval_cache_entry {
-    cortex_move_list game;
-    cortex_eval eval;
-    int depth;
+    uint64_t key; /* position key ^ data */
+    uint64_t data; /* packed score, depth, bound and best move */
 } cortex_eval_cache_entry;
 
-/* Returns 1 if the position was located in the cache, and fills *out with the evaluation if it is. */
-int cortex_eval_try_cache(cortex_board* b, cortex_eval* out, int* out_depth);
+/*
+ * Returns 1 if the position was located in the cache, and fills *out with the score if it is.
+ * <ply> is the distance of the position from the search root, used to rebase mate scores.
+ * Only the from, to and promote_type fields of *out_move are filled.
+ */
+int cortex_eval_try_cache(cortex_board* b, int ply, cortex_score* out, cortex_move* out_move, int* out_depth, int* out_bound);
+
+/* Get the key a position is cached under. */
+uint64_t cortex_eval_cache_key(cortex_board* b);
+
+void cortex_eval_cache_insert(cortex_board* b, int ply, cortex_score score, cortex_move best_move, int depth, int bound);
+
+/* Empty the cache, so entries found with other parameters aren't reused. */
+void cortex_eval_cache_clear();
 
-void cortex_eval_cache_insert(cortex_board* b, cortex_eval eval, int depth);
+/* Estimate how full the cache is, in permille, by sampling its first entries. */
+int cortex_eval_cache_hashfull();
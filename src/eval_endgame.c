@@ -0,0 +1,289 @@
+#include "eval_endgame.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/* KPK positions: the color to move, the black king, the white king, and the pawn on files a to d and ranks 2 to 7. */
+#define CORTEX_EVAL_KPK_SIZE (2 * 64 * 64 * 24)
+
+/* Results while the bitbase is generated. Successor results are or-ed together, so each is a bit. */
+#define CORTEX_EVAL_KPK_INVALID 0
+#define CORTEX_EVAL_KPK_UNKNOWN 1
+#define CORTEX_EVAL_KPK_DRAW    2
+#define CORTEX_EVAL_KPK_WIN     4
+
+/* Score bonuses of known wins. */
+#define CORTEX_EVAL_ENDGAME_PUSH   40 /* per step the defending king is pushed toward the edge */
+#define CORTEX_EVAL_ENDGAME_CORNER 200 /* per step the defending king is pushed toward a corner the bishop covers */
+#define CORTEX_EVAL_ENDGAME_CLOSE  10 /* per step the kings are closer */
+#define CORTEX_EVAL_ENDGAME_PAWN   20 /* per rank a winning pawn has advanced */
+
+static uint64_t _cortex_eval_kpk[CORTEX_EVAL_KPK_SIZE / 64];
+static int _cortex_eval_kpk_ready;
+static pthread_once_t _cortex_eval_kpk_once = PTHREAD_ONCE_INIT;
+
+static void _cortex_eval_kpk_generate();
+static int _cortex_eval_kpk_index(cortex_square wk, cortex_square wp, cortex_square bk, cortex_piece_color to_move);
+static u8 _cortex_eval_kpk_init(int idx);
+static u8 _cortex_eval_kpk_classify(const u8* results, int idx);
+static int _cortex_eval_kpk_pawn_attacks(cortex_square wp, cortex_square sq);
+static cortex_square _cortex_eval_king_step(cortex_square sq, int dir);
+static int _cortex_eval_distance(cortex_square a, cortex_square b);
+static int _cortex_eval_steps(cortex_square a, cortex_square b);
+static int _cortex_eval_edge(cortex_square sq);
+
+int cortex_eval_endgame_probe(cortex_board* b, cortex_score* out) {
+    /* At most a queen, a rook or two minor pieces are left. Kings and pawns don't count toward the phase. */
+    if (b->phase > 4) return CORTEX_EVAL_ENDGAME_NONE;
+
+    /* The non-king pieces, and the king squares. */
+    cortex_piece pieces[2];
+    cortex_square squares[2], kings[2] = { CORTEX_SQUARE_INVALID, CORTEX_SQUARE_INVALID };
+    int count = 0;
+
+    for (int sq = 0; sq < 64; ++sq) {
+        cortex_piece p = b->state[sq];
+        if (!p) continue;
+
+        if (CORTEX_PIECE_GET_TYPE(p) == CORTEX_PIECE_TYPE_KING) {
+            kings[CORTEX_PIECE_GET_COLOR(p)] = sq;
+            continue;
+        }
+
+        if (count == 2) return CORTEX_EVAL_ENDGAME_NONE;
+
+        pieces[count] = p;
+        squares[count++] = sq;
+    }
+
+    if (kings[0] == CORTEX_SQUARE_INVALID || kings[1] == CORTEX_SQUARE_INVALID) return CORTEX_EVAL_ENDGAME_NONE;
+
+    /* Bare kings, or a lone minor piece, can't mate. */
+    if (!count || (count == 1 && (CORTEX_PIECE_GET_TYPE(pieces[0]) == CORTEX_PIECE_TYPE_KNIGHT || CORTEX_PIECE_GET_TYPE(pieces[0]) == CORTEX_PIECE_TYPE_BISHOP))) {
+        *out = 0;
+        return CORTEX_EVAL_ENDGAME_DRAW;
+    }
+
+    cortex_piece_color strong = CORTEX_PIECE_GET_COLOR(pieces[0]);
+    if (count == 2 && CORTEX_PIECE_GET_COLOR(pieces[1]) != strong) return CORTEX_EVAL_ENDGAME_NONE;
+
+    cortex_square attacker = kings[strong], defender = kings[!strong];
+    cortex_score score;
+
+    if (count == 1 && CORTEX_PIECE_GET_TYPE(pieces[0]) == CORTEX_PIECE_TYPE_PAWN) {
+        /* The bitbase has white's pawn, so a black pawn is seen with the board flipped. */
+        cortex_square pawn = squares[0];
+        cortex_piece_color to_move = b->color_to_move;
+
+        if (strong != CORTEX_PIECE_COLOR_WHITE) {
+            attacker ^= 56;
+            defender ^= 56;
+            pawn ^= 56;
+            to_move = !to_move;
+        }
+
+        int win = cortex_eval_endgame_kpk(attacker, pawn, defender, to_move);
+        if (win < 0) return CORTEX_EVAL_ENDGAME_NONE;
+
+        if (!win) {
+            *out = 0;
+            return CORTEX_EVAL_ENDGAME_DRAW;
+        }
+
+        score = CORTEX_EVAL_KNOWN_WIN + cortex_eval_piece_value(pieces[0]) + (CORTEX_SQUARE_RANK(pawn) - 2) * CORTEX_EVAL_ENDGAME_PAWN;
+    } else if (count == 1 && (CORTEX_PIECE_GET_TYPE(pieces[0]) == CORTEX_PIECE_TYPE_ROOK || CORTEX_PIECE_GET_TYPE(pieces[0]) == CORTEX_PIECE_TYPE_QUEEN)) {
+        /* KRK and KQK: mate on the edge. */
+        score = CORTEX_EVAL_KNOWN_WIN + cortex_eval_piece_value(pieces[0]) + _cortex_eval_edge(defender) * CORTEX_EVAL_ENDGAME_PUSH;
+        score += (7 - _cortex_eval_distance(attacker, defender)) * CORTEX_EVAL_ENDGAME_CLOSE;
+    } else if (count == 2 && CORTEX_PIECE_IS_MINOR(pieces[0]) && CORTEX_PIECE_IS_MINOR(pieces[1]) && CORTEX_PIECE_GET_TYPE(pieces[0]) + CORTEX_PIECE_GET_TYPE(pieces[1]) == CORTEX_PIECE_TYPE_BISHOP + CORTEX_PIECE_TYPE_KNIGHT) {
+        /* KBNK: mate only works in a corner of the bishop's color. a1 is dark. */
+        cortex_square bishop = (CORTEX_PIECE_GET_TYPE(pieces[0]) == CORTEX_PIECE_TYPE_BISHOP) ? squares[0] : squares[1];
+        int dark = (CORTEX_SQUARE_RANK(bishop) + CORTEX_SQUARE_FILE(bishop)) % 2 == 0;
+
+        /* Steps to the nearer of the bishop's corners, a1 and h8 or a8 and h1. It is never more than 7. */
+        cortex_square corner = dark ? CORTEX_SQUARE_AT(1, 1) : CORTEX_SQUARE_AT(8, 1);
+        int near = _cortex_eval_steps(defender, corner), far = _cortex_eval_steps(defender, corner ^ 63);
+        int corner_dist = near < far ? near : far;
+
+        score = CORTEX_EVAL_KNOWN_WIN + cortex_eval_piece_value(pieces[0]) + cortex_eval_piece_value(pieces[1]) + (7 - corner_dist) * CORTEX_EVAL_ENDGAME_CORNER;
+        score += (7 - _cortex_eval_distance(attacker, defender)) * CORTEX_EVAL_ENDGAME_CLOSE;
+    } else {
+        return CORTEX_EVAL_ENDGAME_NONE;
+    }
+
+    *out = (strong == CORTEX_PIECE_COLOR_WHITE) ? score : -score;
+    return CORTEX_EVAL_ENDGAME_WIN;
+}
+
+int cortex_eval_endgame_kpk(cortex_square wk, cortex_square wp, cortex_square bk, cortex_piece_color to_move) {
+    pthread_once(&_cortex_eval_kpk_once, _cortex_eval_kpk_generate);
+    if (!_cortex_eval_kpk_ready) return -1;
+
+    /* The board is symmetric across the d and e files. */
+    if (CORTEX_SQUARE_FILE(wp) > 4) {
+        wk ^= 7;
+        wp ^= 7;
+        bk ^= 7;
+    }
+
+    int idx = _cortex_eval_kpk_index(wk, wp, bk, to_move);
+    return (_cortex_eval_kpk[idx / 64] >> (idx % 64)) & 1;
+}
+
+/*
+ * Retrograde analysis. Positions decided by themselves are marked first: a safe promotion wins, and
+ * a stalemate or a free pawn capture draws. Then the rest are decided from their successors until nothing
+ * changes. White wins if a move leads to a win, black draws if a move leads to a draw. What is left is drawn.
+ */
+static void _cortex_eval_kpk_generate() {
+    u8* results = malloc(CORTEX_EVAL_KPK_SIZE);
+    if (!results) return;
+
+    for (int idx = 0; idx < CORTEX_EVAL_KPK_SIZE; ++idx) {
+        results[idx] = _cortex_eval_kpk_init(idx);
+    }
+
+    /* Pawn moves only go forward, so each pawn square is settled from rank 7 down before the squares behind it. */
+    for (int rank = 7; rank >= 2; --rank) {
+        for (int file = 0; file < 4; ++file) {
+            int first = (file * 6 + rank - 2) * 8192;
+
+            for (int changed = 1; changed;) {
+                changed = 0;
+
+                for (int idx = first; idx < first + 8192; ++idx) {
+                    if (results[idx] != CORTEX_EVAL_KPK_UNKNOWN) continue;
+
+                    results[idx] = _cortex_eval_kpk_classify(results, idx);
+                    changed |= results[idx] != CORTEX_EVAL_KPK_UNKNOWN;
+                }
+            }
+        }
+    }
+
+    for (int idx = 0; idx < CORTEX_EVAL_KPK_SIZE; ++idx) {
+        if (results[idx] == CORTEX_EVAL_KPK_WIN) _cortex_eval_kpk[idx / 64] |= 1ULL << (idx % 64);
+    }
+
+    free(results);
+    _cortex_eval_kpk_ready = 1;
+}
+
+static int _cortex_eval_kpk_index(cortex_square wk, cortex_square wp, cortex_square bk, cortex_piece_color to_move) {
+    int pawn = (CORTEX_SQUARE_FILE(wp) - 1) * 6 + CORTEX_SQUARE_RANK(wp) - 2;
+    return to_move + 2 * (bk + 64 * (wk + 64 * pawn));
+}
+
+/* Result of a position by itself: INVALID, WIN, DRAW, or UNKNOWN if it depends on the moves. */
+static u8 _cortex_eval_kpk_init(int idx) {
+    cortex_piece_color to_move = idx % 2;
+    cortex_square bk = (idx / 2) % 64, wk = (idx / 128) % 64;
+    int pawn = idx / 8192;
+    cortex_square wp = CORTEX_SQUARE_AT(pawn % 6 + 2, pawn / 6 + 1);
+
+    if (_cortex_eval_distance(wk, bk) <= 1 || wk == wp || bk == wp) return CORTEX_EVAL_KPK_INVALID;
+
+    if (to_move == CORTEX_PIECE_COLOR_WHITE) {
+        /* Black can't be in check with white to move. */
+        if (_cortex_eval_kpk_pawn_attacks(wp, bk)) return CORTEX_EVAL_KPK_INVALID;
+
+        /* Promote if the new queen can't be taken. */
+        cortex_square promotion = wp + 8;
+
+        if (CORTEX_SQUARE_RANK(wp) == 7 && promotion != wk && promotion != bk) {
+            if (_cortex_eval_distance(bk, promotion) > 1 || _cortex_eval_distance(wk, promotion) == 1) return CORTEX_EVAL_KPK_WIN;
+        }
+
+        return CORTEX_EVAL_KPK_UNKNOWN;
+    }
+
+    /* Black takes an undefended pawn. */
+    if (_cortex_eval_distance(bk, wp) == 1 && _cortex_eval_distance(wk, wp) > 1) return CORTEX_EVAL_KPK_DRAW;
+
+    /* Stalemate. A pawn can't mate, so no moves means stalemate. */
+    for (int dir = 0; dir < 8; ++dir) {
+        cortex_square to = _cortex_eval_king_step(bk, dir);
+
+        if (to != CORTEX_SQUARE_INVALID && to != wp && _cortex_eval_distance(to, wk) > 1 && !_cortex_eval_kpk_pawn_attacks(wp, to)) {
+            return CORTEX_EVAL_KPK_UNKNOWN;
+        }
+    }
+
+    return CORTEX_EVAL_KPK_DRAW;
+}
+
+/* Result of a position from its successors. Illegal moves lead to INVALID positions and add nothing. */
+static u8 _cortex_eval_kpk_classify(const u8* results, int idx) {
+    cortex_piece_color to_move = idx % 2;
+    cortex_square bk = (idx / 2) % 64, wk = (idx / 128) % 64;
+    int pawn = idx / 8192;
+    cortex_square wp = CORTEX_SQUARE_AT(pawn % 6 + 2, pawn / 6 + 1);
+
+    u8 found = 0;
+
+    if (to_move == CORTEX_PIECE_COLOR_WHITE) {
+        for (int dir = 0; dir < 8; ++dir) {
+            cortex_square to = _cortex_eval_king_step(wk, dir);
+            if (to != CORTEX_SQUARE_INVALID) found |= results[_cortex_eval_kpk_index(to, wp, bk, CORTEX_PIECE_COLOR_BLACK)];
+            if (found & CORTEX_EVAL_KPK_WIN) return CORTEX_EVAL_KPK_WIN;
+        }
+
+        /* Promotions were decided by the first pass. */
+        if (CORTEX_SQUARE_RANK(wp) < 7) {
+            found |= results[_cortex_eval_kpk_index(wk, wp + 8, bk, CORTEX_PIECE_COLOR_BLACK)];
+
+            if (CORTEX_SQUARE_RANK(wp) == 2 && wp + 8 != wk && wp + 8 != bk) {
+                found |= results[_cortex_eval_kpk_index(wk, wp + 16, bk, CORTEX_PIECE_COLOR_BLACK)];
+            }
+        }
+
+        if (found & CORTEX_EVAL_KPK_WIN) return CORTEX_EVAL_KPK_WIN;
+        return (found & CORTEX_EVAL_KPK_UNKNOWN) ? CORTEX_EVAL_KPK_UNKNOWN : CORTEX_EVAL_KPK_DRAW;
+    }
+
+    for (int dir = 0; dir < 8; ++dir) {
+        cortex_square to = _cortex_eval_king_step(bk, dir);
+        if (to != CORTEX_SQUARE_INVALID) found |= results[_cortex_eval_kpk_index(wk, wp, to, CORTEX_PIECE_COLOR_WHITE)];
+        if (found & CORTEX_EVAL_KPK_DRAW) return CORTEX_EVAL_KPK_DRAW;
+    }
+
+    if (found & CORTEX_EVAL_KPK_DRAW) return CORTEX_EVAL_KPK_DRAW;
+    return (found & CORTEX_EVAL_KPK_UNKNOWN) ? CORTEX_EVAL_KPK_UNKNOWN : CORTEX_EVAL_KPK_WIN;
+}
+
+static int _cortex_eval_kpk_pawn_attacks(cortex_square wp, cortex_square sq) {
+    int df = CORTEX_SQUARE_FILE(sq) - CORTEX_SQUARE_FILE(wp);
+    return CORTEX_SQUARE_RANK(sq) == CORTEX_SQUARE_RANK(wp) + 1 && (df == 1 || df == -1);
+}
+
+/* The square one king step away in direction <dir> (0 to 7), or CORTEX_SQUARE_INVALID off the board. */
+static cortex_square _cortex_eval_king_step(cortex_square sq, int dir) {
+    static const int steps[8][2] = { { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, -1 }, { 0, 1 }, { -1, -1 }, { -1, 0 }, { -1, 1 } };
+
+    int rank = CORTEX_SQUARE_RANK(sq) + steps[dir][0], file = CORTEX_SQUARE_FILE(sq) + steps[dir][1];
+    if (rank < 1 || rank > 8 || file < 1 || file > 8) return CORTEX_SQUARE_INVALID;
+
+    return CORTEX_SQUARE_AT(rank, file);
+}
+
+/* King steps between two squares. */
+static int _cortex_eval_distance(cortex_square a, cortex_square b) {
+    int ranks = abs(CORTEX_SQUARE_RANK(a) - CORTEX_SQUARE_RANK(b));
+    int files = abs(CORTEX_SQUARE_FILE(a) - CORTEX_SQUARE_FILE(b));
+
+    return ranks > files ? ranks : files;
+}
+
+/* King steps from the four center squares, 0 to 3. */
+/* King steps between two squares when only moving along ranks and files. */
+static int _cortex_eval_steps(cortex_square a, cortex_square b) {
+    return abs(CORTEX_SQUARE_RANK(a) - CORTEX_SQUARE_RANK(b)) + abs(CORTEX_SQUARE_FILE(a) - CORTEX_SQUARE_FILE(b));
+}
+
+static int _cortex_eval_edge(cortex_square sq) {
+    int rank = CORTEX_SQUARE_RANK(sq), file = CORTEX_SQUARE_FILE(sq);
+    int rank_dist = rank <= 4 ? 4 - rank : rank - 5;
+    int file_dist = file <= 4 ? 4 - file : file - 5;
+
+    return rank_dist > file_dist ? rank_dist : file_dist;
+}
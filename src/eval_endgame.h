@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+ * Endgame recognizers.
+ * Endgames with a known result or a known winning plan are scored directly instead of by the general
+ * evaluation. Bare kings and a lone minor piece are draws. KPK is looked up in a bitbase. KRK, KQK and
+ * KBNK drive the defending king to the edge, or to a corner the bishop covers, with the attacking king close.
+ *
+ * The KPK bitbase holds one bit per position with the pawn on files a to d, 24KB. It is generated by
+ * retrograde analysis the first time it is needed, in milliseconds.
+ */
+
+#include "eval.h"
+
+/* Recognized endgames. */
+#define CORTEX_EVAL_ENDGAME_NONE 0
+#define CORTEX_EVAL_ENDGAME_DRAW 1 /* a draw whatever either side plays, scored 0 */
+#define CORTEX_EVAL_ENDGAME_WIN  2 /* a win for one side, scored to make progress */
+#define CORTEX_EVAL_ENDGAME_UNPROBED -1 /* not a result, the search hasn't probed the position yet */
+
+/* Known wins score from this up, more than any material balance but less than a mate. */
+#define CORTEX_EVAL_KNOWN_WIN 10000
+
+/*
+ * Recognize the position, and if it is a known endgame put its score in *out. (white-black)
+ * Returns a CORTEX_EVAL_ENDGAME_* result.
+ */
+int cortex_eval_endgame_probe(cortex_board* b, cortex_score* out);
+
+/* Look up a white king, white pawn and black king in the KPK bitbase. Returns 1 if white wins, 0 if not, -1 if it couldn't be generated. */
+int cortex_eval_endgame_kpk(cortex_square wk, cortex_square wp, cortex_square bk, cortex_piece_color to_move);
@@ -0,0 +1,187 @@
+#include "eval.h"
+#include "eval_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Mate search.
+ * A null-window search around "mate found or not", deepened one attacking move at a time so the first
+ * mate found is a shortest one. Positions without a mate inside the horizon score 0.
+ */
+
+#define CORTEX_EVAL_MATE_CACHE_SIZE (1 << 18) /* must be a power of two */
+
+/* Cached mate search result. Scores only mean "mate in so many plies" or "no mate within depth". */
+typedef struct _cortex_eval_mate_entry {
+    uint64_t key;
+    int16_t score;
+    u8 depth, bound;
+    cortex_square from, to;
+    cortex_piece_type promote_type;
+} cortex_eval_mate_entry;
+
+typedef struct _cortex_eval_mate_ctx {
+    cortex_eval_mate_entry* cache;
+    cortex_move root_move;
+} cortex_eval_mate_ctx;
+
+static cortex_score _cortex_eval_mate_search(cortex_eval_mate_ctx* ctx, cortex_board* b, int depth, int ply, cortex_score alpha, cortex_score beta);
+static int _cortex_eval_mate_order(cortex_move m, int attacking, cortex_eval_mate_entry* hit);
+
+int cortex_eval_mate(cortex_board* b, int moves, cortex_move* best_move) {
+    if (!b || moves < 1) return -1;
+
+    cortex_eval_mate_ctx ctx;
+
+    /* Each search has its own cache so independent positions can be solved in parallel. */
+    ctx.cache = calloc(CORTEX_EVAL_MATE_CACHE_SIZE, sizeof *ctx.cache);
+    if (!ctx.cache) return -1;
+
+    if (moves > CORTEX_EVAL_MAX_PLY / 2) moves = CORTEX_EVAL_MAX_PLY / 2;
+
+    int result = 0;
+
+    for (int n = 1; n <= moves && b->legal_moves.len; ++n) {
+        cortex_score score = _cortex_eval_mate_search(&ctx, b, 2 * n - 1, 0, 0, 1);
+
+        if (score >= CORTEX_SCORE_MATE_BOUND) {
+            result = CORTEX_SCORE_MATE_IN(score);
+            if (best_move) *best_move = ctx.root_move;
+            break;
+        }
+    }
+
+    free(ctx.cache);
+    return result;
+}
+
+/*
+ * Negamax over mate scores. The attacker moves at odd remaining depths, the defender at even ones.
+ * The attacker's last move can only mate if it gives check, and the move generator already marks mating
+ * moves, so the last attacking ply is answered without expanding any children.
+ */
+static cortex_score _cortex_eval_mate_search(cortex_eval_mate_ctx* ctx, cortex_board* b, int depth, int ply, cortex_score alpha, cortex_score beta) {
+    /* Mate distance pruning: no line from here can beat a mate already in reach closer to the root. */
+    if (alpha < -CORTEX_SCORE_MATE + ply) alpha = -CORTEX_SCORE_MATE + ply;
+    if (beta > CORTEX_SCORE_MATE - ply - 1) beta = CORTEX_SCORE_MATE - ply - 1;
+    if (alpha >= beta) return alpha;
+
+    if (!b->legal_moves.len) {
+        return cortex_eval_in_check(b) ? -CORTEX_SCORE_MATE + ply : 0;
+    }
+
+    /* A drawn line can't be part of the shortest mate. */
+    if (ply && cortex_board_is_draw(b, 1)) return 0;
+
+    int attacking = depth & 1;
+
+    if (attacking && depth == 1) {
+        for (int i = 0; i < b->legal_moves.len; ++i) {
+            if (b->legal_moves.list[i].move_attr & CORTEX_MOVE_ATTR_MATE) {
+                if (!ply) ctx->root_move = b->legal_moves.list[i];
+                return CORTEX_SCORE_MATE - (ply + 1);
+            }
+        }
+
+        return 0;
+    }
+
+    uint64_t key = cortex_eval_cache_key(b);
+    cortex_eval_mate_entry* entry = ctx->cache + (key & (CORTEX_EVAL_MATE_CACHE_SIZE - 1));
+    cortex_eval_mate_entry* hit = (entry->key == key) ? entry : NULL;
+
+    if (hit && ply && hit->depth >= depth) {
+        cortex_score cached = hit->score;
+
+        if (cached >= CORTEX_SCORE_MATE_BOUND) cached -= ply;
+        if (cached <= -CORTEX_SCORE_MATE_BOUND) cached += ply;
+
+        if (hit->bound == CORTEX_EVAL_CACHE_EXACT) return cached;
+        if (hit->bound == CORTEX_EVAL_CACHE_LOWER && cached >= beta) return cached;
+        if (hit->bound == CORTEX_EVAL_CACHE_UPPER && cached <= alpha) return cached;
+    }
+
+    int order[b->legal_moves.len];
+    int order_score[b->legal_moves.len];
+
+    for (int i = 0; i < b->legal_moves.len; ++i) {
+        order[i] = i;
+        order_score[i] = _cortex_eval_mate_order(b->legal_moves.list[i], attacking, hit);
+    }
+
+    cortex_score alpha_orig = alpha, best_score = -CORTEX_SCORE_INFINITY;
+    cortex_move best_move = b->legal_moves.list[0];
+
+    for (int i = 0; i < b->legal_moves.len; ++i) {
+        for (int j = i + 1; j < b->legal_moves.len; ++j) {
+            if (order_score[j] > order_score[i]) {
+                int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+                tmp = order_score[i]; order_score[i] = order_score[j]; order_score[j] = tmp;
+            }
+        }
+
+        cortex_move move = b->legal_moves.list[order[i]];
+        cortex_score score;
+
+        if (move.move_attr & CORTEX_MOVE_ATTR_MATE) {
+            score = CORTEX_SCORE_MATE - (ply + 1);
+        } else {
+            cortex_board tmp_board;
+            memcpy(&tmp_board, b, sizeof tmp_board);
+            cortex_board_apply_move(&tmp_board, move);
+
+            score = -_cortex_eval_mate_search(ctx, &tmp_board, depth - 1, ply + 1, -beta, -alpha);
+        }
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+        }
+
+        if (best_score > alpha) alpha = best_score;
+        if (alpha >= beta) break;
+    }
+
+    if (!ply) ctx->root_move = best_move;
+
+    int bound = CORTEX_EVAL_CACHE_EXACT;
+
+    if (best_score <= alpha_orig) {
+        bound = CORTEX_EVAL_CACHE_UPPER;
+    } else if (best_score >= beta) {
+        bound = CORTEX_EVAL_CACHE_LOWER;
+    }
+
+    cortex_score stored = best_score;
+
+    if (stored >= CORTEX_SCORE_MATE_BOUND) stored += ply;
+    if (stored <= -CORTEX_SCORE_MATE_BOUND) stored -= ply;
+
+    entry->key = key;
+    entry->score = stored;
+    entry->depth = depth;
+    entry->bound = bound;
+    entry->from = best_move.from;
+    entry->to = best_move.to;
+    entry->promote_type = best_move.promote_type;
+
+    return best_score;
+}
+
+/* The attacker tries checks first, the defender captures (removing attackers) first. */
+static int _cortex_eval_mate_order(cortex_move m, int attacking, cortex_eval_mate_entry* hit) {
+    if (m.move_attr & CORTEX_MOVE_ATTR_MATE) return 1 << 20;
+
+    if (hit && m.from == hit->from && m.to == hit->to && m.promote_type == hit->promote_type) {
+        return 1 << 19;
+    }
+
+    int score = 0;
+
+    if (attacking && (m.move_attr & CORTEX_MOVE_ATTR_CHECK)) score += 1 << 16;
+    if (m.move_type == CORTEX_MOVE_TYPE_CAPTURE) score += 1 << 15;
+    if (m.move_attr & CORTEX_MOVE_ATTR_PROMOTE) score += 1 << 14;
+
+    return score;
+}
@@ -0,0 +1,234 @@
+#include "eval_mcts.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int _cortex_eval_mcts_expand(cortex_eval_mcts_tree* t, uint32_t n, cortex_board* b);
+static uint32_t _cortex_eval_mcts_select(cortex_eval_mcts_tree* t, uint32_t n);
+static uint32_t _cortex_eval_mcts_most_visited(cortex_eval_mcts_tree* t, uint32_t n);
+static float _cortex_eval_mcts_value(cortex_board* b);
+static float _cortex_eval_mcts_prior(cortex_board* b, cortex_move m);
+
+int cortex_eval_mcts_init(cortex_eval_mcts_tree* t, cortex_board* b, size_t memory) {
+    t->size = memory / sizeof *t->nodes;
+    if (t->size > UINT32_MAX) t->size = UINT32_MAX;
+    if (t->size < 1) return -1;
+
+    t->nodes = malloc((size_t) t->size * sizeof *t->nodes);
+    if (!t->nodes) return -1;
+
+    memset(t->nodes, 0, sizeof *t->nodes);
+    memcpy(&t->root, b, sizeof t->root);
+    t->len = 1;
+
+    return 0;
+}
+
+void cortex_eval_mcts_free(cortex_eval_mcts_tree* t) {
+    free(t->nodes);
+    t->nodes = NULL;
+}
+
+/*
+ * Playouts count themselves into each node's visits on the way down and only add their result on the
+ * way back up, so until then they read as losses and other threads spread out to other branches.
+ */
+void cortex_eval_mcts_playout(cortex_eval_mcts_tree* t) {
+    cortex_board pos;
+    memcpy(&pos, &t->root, sizeof pos);
+
+    uint32_t path[CORTEX_EVAL_MAX_PLY + 1];
+    int len = 0;
+    uint32_t n = 0;
+    float result; /* for the color to move at the end of the path */
+
+    __atomic_add_fetch(&t->nodes[0].visits, 1, __ATOMIC_RELAXED);
+    path[len++] = 0;
+
+    for (;;) {
+        if (!pos.legal_moves.len) {
+            result = cortex_eval_in_check(&pos) ? 0.0f : 0.5f;
+            break;
+        }
+
+        if (len > 1 && cortex_board_is_draw(&pos, 1)) {
+            result = 0.5f;
+            break;
+        }
+
+        if (len > CORTEX_EVAL_MAX_PLY) {
+            result = _cortex_eval_mcts_value(&pos);
+            break;
+        }
+
+        cortex_eval_mcts_node* node = t->nodes + n;
+        u8 state = __atomic_load_n(&node->state, __ATOMIC_ACQUIRE);
+
+        if (state != CORTEX_EVAL_MCTS_NODE_EXPANDED) {
+            /* One thread expands a leaf, the others just score it. A leaf that didn't fit stays unexpanded for good. */
+            u8 expected = CORTEX_EVAL_MCTS_NODE_LEAF;
+
+            if (__atomic_compare_exchange_n(&node->state, &expected, CORTEX_EVAL_MCTS_NODE_EXPANDING, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                _cortex_eval_mcts_expand(t, n, &pos);
+            }
+
+            result = _cortex_eval_mcts_value(&pos);
+            break;
+        }
+
+        n = _cortex_eval_mcts_select(t, n);
+        __atomic_add_fetch(&t->nodes[n].visits, 1, __ATOMIC_RELAXED);
+        path[len++] = n;
+
+        cortex_board_apply_move(&pos, pos.legal_moves.list[t->nodes[n].index]);
+    }
+
+    /* Each node keeps the result for the color that moved into it, so the sides alternate going up. */
+    float v = 1.0f - result;
+
+    for (int i = len - 1; i >= 0; --i) {
+        __atomic_add_fetch(&t->nodes[path[i]].value, (int64_t) (v * CORTEX_EVAL_MCTS_FIXED), __ATOMIC_RELAXED);
+        v = 1.0f - v;
+    }
+}
+
+int cortex_eval_mcts_best(cortex_eval_mcts_tree* t, cortex_move* best_move, cortex_score* score) {
+    if (__atomic_load_n(&t->nodes[0].state, __ATOMIC_ACQUIRE) != CORTEX_EVAL_MCTS_NODE_EXPANDED) return -1;
+
+    cortex_eval_mcts_node* best = t->nodes + _cortex_eval_mcts_most_visited(t, 0);
+    int32_t visits = __atomic_load_n(&best->visits, __ATOMIC_RELAXED);
+
+    float q = visits ? (float) __atomic_load_n(&best->value, __ATOMIC_RELAXED) / CORTEX_EVAL_MCTS_FIXED / visits : 0.5f;
+
+    if (q < 0.001f) q = 0.001f;
+    if (q > 0.999f) q = 0.999f;
+
+    if (best_move) *best_move = t->root.legal_moves.list[best->index];
+    if (score) *score = (cortex_score) (-CORTEX_EVAL_MCTS_SCALE * log10f(1.0f / q - 1.0f));
+
+    return 0;
+}
+
+int cortex_eval_mcts_pv(cortex_eval_mcts_tree* t, cortex_move* out, int max) {
+    cortex_board pos;
+    memcpy(&pos, &t->root, sizeof pos);
+
+    uint32_t n = 0;
+    int len = 0;
+
+    while (len < max && __atomic_load_n(&t->nodes[n].state, __ATOMIC_ACQUIRE) == CORTEX_EVAL_MCTS_NODE_EXPANDED) {
+        n = _cortex_eval_mcts_most_visited(t, n);
+        if (!__atomic_load_n(&t->nodes[n].visits, __ATOMIC_RELAXED)) break;
+
+        out[len++] = pos.legal_moves.list[t->nodes[n].index];
+        cortex_board_apply_move(&pos, out[len - 1]);
+    }
+
+    return len;
+}
+
+uint64_t cortex_eval_mcts_playouts(cortex_eval_mcts_tree* t) {
+    return __atomic_load_n(&t->nodes[0].visits, __ATOMIC_RELAXED);
+}
+
+/* Allocate the children of a node the calling thread has claimed. Returns -1 if the arena is full. */
+static int _cortex_eval_mcts_expand(cortex_eval_mcts_tree* t, uint32_t n, cortex_board* b) {
+    uint32_t count = b->legal_moves.len;
+    uint32_t first = __atomic_load_n(&t->len, __ATOMIC_RELAXED);
+
+    do {
+        if (t->size - first < count) return -1;
+    } while (!__atomic_compare_exchange_n(&t->len, &first, first + count, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    float priors[count], total = 0.0f;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        priors[i] = _cortex_eval_mcts_prior(b, b->legal_moves.list[i]);
+        total += priors[i];
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        cortex_eval_mcts_node* child = t->nodes + first + i;
+
+        memset(child, 0, sizeof *child);
+        child->prior = priors[i] / total;
+        child->index = i;
+    }
+
+    cortex_eval_mcts_node* node = t->nodes + n;
+
+    node->first_child = first;
+    node->child_count = count;
+    __atomic_store_n(&node->state, CORTEX_EVAL_MCTS_NODE_EXPANDED, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/*
+ * PUCT: the child with the best mean result plus an exploration bonus weighted by its prior.
+ * Unvisited children are assumed as good as the node itself.
+ */
+static uint32_t _cortex_eval_mcts_select(cortex_eval_mcts_tree* t, uint32_t n) {
+    cortex_eval_mcts_node* node = t->nodes + n;
+
+    int32_t visits = __atomic_load_n(&node->visits, __ATOMIC_RELAXED);
+    float node_q = visits ? 1.0f - (float) __atomic_load_n(&node->value, __ATOMIC_RELAXED) / CORTEX_EVAL_MCTS_FIXED / visits : 0.5f;
+    float explore = CORTEX_EVAL_MCTS_CPUCT * sqrtf((float) visits);
+
+    uint32_t best = node->first_child;
+    float best_score = -INFINITY;
+
+    for (uint32_t c = node->first_child; c < node->first_child + node->child_count; ++c) {
+        cortex_eval_mcts_node* child = t->nodes + c;
+        int32_t child_visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED);
+
+        float q = child_visits ? (float) __atomic_load_n(&child->value, __ATOMIC_RELAXED) / CORTEX_EVAL_MCTS_FIXED / child_visits : node_q;
+        float score = q + explore * child->prior / (1 + child_visits);
+
+        if (score > best_score) {
+            best_score = score;
+            best = c;
+        }
+    }
+
+    return best;
+}
+
+static uint32_t _cortex_eval_mcts_most_visited(cortex_eval_mcts_tree* t, uint32_t n) {
+    cortex_eval_mcts_node* node = t->nodes + n;
+    uint32_t best = node->first_child;
+
+    for (uint32_t c = node->first_child + 1; c < node->first_child + node->child_count; ++c) {
+        if (__atomic_load_n(&t->nodes[c].visits, __ATOMIC_RELAXED) > __atomic_load_n(&t->nodes[best].visits, __ATOMIC_RELAXED)) {
+            best = c;
+        }
+    }
+
+    return best;
+}
+
+/* Win probability of the static evaluation for the color to move. */
+static float _cortex_eval_mcts_value(cortex_board* b) {
+    cortex_score score = cortex_eval_immediate(b);
+    if (b->color_to_move != CORTEX_PIECE_COLOR_WHITE) score = -score;
+
+    return 1.0f / (1.0f + powf(10.0f, -score / CORTEX_EVAL_MCTS_SCALE));
+}
+
+/* Unnormalized prior of a move, favouring mates, captures of big pieces, promotions and checks. */
+static float _cortex_eval_mcts_prior(cortex_board* b, cortex_move m) {
+    if (m.move_attr & CORTEX_MOVE_ATTR_MATE) return 100.0f;
+
+    float prior = 1.0f;
+
+    if (m.move_type == CORTEX_MOVE_TYPE_CAPTURE) {
+        cortex_score victim = m.is_en_passant ? cortex_eval_piece_value(CORTEX_PIECE_TYPE_PAWN) : cortex_eval_piece_value(b->state[m.to]);
+        prior += victim / 100.0f;
+    }
+
+    if (m.move_attr & CORTEX_MOVE_ATTR_PROMOTE) prior += cortex_eval_piece_value(m.promote_type) / 100.0f;
+    if (m.move_attr & CORTEX_MOVE_ATTR_CHECK) prior += 1.0f;
+
+    return prior;
+}
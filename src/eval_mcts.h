@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * Monte Carlo tree search.
+ * Any number of threads run playouts on one shared tree without locks. Nodes come from an arena
+ * allocated when the search starts; a playout descends with PUCT, expands the leaf it reaches,
+ * scores it with the static evaluation and backs the result up the path.
+ */
+
+#include "board.h"
+#include "eval.h"
+
+/* Size of the tree arena. */
+#define CORTEX_EVAL_MCTS_MEMORY (64 << 20)
+
+/* Playouts in a normal (not pondering) search. */
+#define CORTEX_EVAL_MCTS_PLAYOUTS 4000
+
+/* Exploration constant of the PUCT formula. */
+#define CORTEX_EVAL_MCTS_CPUCT 1.5f
+
+/* Centipawn scale of the static evaluation to win probability conversion. */
+#define CORTEX_EVAL_MCTS_SCALE 400.0f
+
+/* Values are summed as fixed point so threads can add them atomically. */
+#define CORTEX_EVAL_MCTS_FIXED 65536
+
+#define CORTEX_EVAL_MCTS_NODE_LEAF      0
+#define CORTEX_EVAL_MCTS_NODE_EXPANDING 1
+#define CORTEX_EVAL_MCTS_NODE_EXPANDED  2
+
+typedef struct _cortex_eval_mcts_node {
+    int64_t value; /* summed results for the color that moved into the node, fixed point */
+    uint32_t first_child;
+    int32_t visits; /* includes playouts still in flight, which count as losses until backed up (virtual loss) */
+    float prior;
+    u8 child_count;
+    u8 index; /* move number in the parent's legal move list */
+    u8 state; /* CORTEX_EVAL_MCTS_NODE_* */
+} cortex_eval_mcts_node;
+
+typedef struct _cortex_eval_mcts_tree {
+    cortex_eval_mcts_node* nodes;
+    uint32_t len, size;
+    cortex_board root;
+} cortex_eval_mcts_tree;
+
+/* Allocate a tree of up to <memory> bytes over a position. Returns -1 on error. */
+int cortex_eval_mcts_init(cortex_eval_mcts_tree* t, cortex_board* b, size_t memory);
+void cortex_eval_mcts_free(cortex_eval_mcts_tree* t);
+
+/* Run one playout. Safe to call from several threads at once. */
+void cortex_eval_mcts_playout(cortex_eval_mcts_tree* t);
+
+/* Get the most visited root move and its score, as a centipawn score for the color to move. Returns -1 if the root has no moves. */
+int cortex_eval_mcts_best(cortex_eval_mcts_tree* t, cortex_move* best_move, cortex_score* score);
+
+/* Get the most visited line from the root. Returns its length. */
+int cortex_eval_mcts_pv(cortex_eval_mcts_tree* t, cortex_move* out, int max);
+
+/* Get the number of playouts run so far. */
+uint64_t cortex_eval_mcts_playouts(cortex_eval_mcts_tree* t);
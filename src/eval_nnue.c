@@ -0,0 +1,196 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "eval_nnue.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if !defined(CORTEX_EVAL_NNUE_SCALAR) && defined(__AVX2__)
+#define CORTEX_EVAL_NNUE_AVX2
+#include <immintrin.h>
+#elif !defined(CORTEX_EVAL_NNUE_SCALAR) && defined(__SSE2__)
+#define CORTEX_EVAL_NNUE_SSE2
+#include <emmintrin.h>
+#endif
+
+static const cortex_eval_nnue_net* _cortex_eval_nnue_net;
+
+static int _cortex_eval_nnue_feature(cortex_square sq, cortex_piece p, cortex_piece_color view);
+static void _cortex_eval_nnue_clip(const int16_t* in, int16_t* out, int len);
+static int32_t _cortex_eval_nnue_dot(const int16_t* a, const int16_t* b, int len);
+
+int cortex_eval_nnue_load(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+
+    if (fstat(fd, &st) || st.st_size != sizeof(cortex_eval_nnue_net)) {
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, sizeof(cortex_eval_nnue_net), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) return -1;
+
+    const cortex_eval_nnue_net* net = map;
+
+    if (memcmp(net->magic, CORTEX_EVAL_NNUE_MAGIC, sizeof net->magic) || net->version != CORTEX_EVAL_NNUE_VERSION) {
+        munmap(map, sizeof(cortex_eval_nnue_net));
+        return -1;
+    }
+
+    cortex_eval_nnue_unload();
+    _cortex_eval_nnue_net = net;
+
+    return 0;
+}
+
+void cortex_eval_nnue_unload() {
+    if (!_cortex_eval_nnue_net) return;
+
+    munmap((void*) _cortex_eval_nnue_net, sizeof(cortex_eval_nnue_net));
+    _cortex_eval_nnue_net = NULL;
+}
+
+int cortex_eval_nnue_loaded() {
+    return _cortex_eval_nnue_net != NULL;
+}
+
+void cortex_eval_nnue_refresh(cortex_eval_nnue_accumulator* acc) {
+    if (!_cortex_eval_nnue_net) return;
+
+    memcpy(acc->values[0], _cortex_eval_nnue_net->hidden_bias, sizeof acc->values[0]);
+    memcpy(acc->values[1], _cortex_eval_nnue_net->hidden_bias, sizeof acc->values[1]);
+}
+
+void cortex_eval_nnue_update(cortex_eval_nnue_accumulator* acc, cortex_square sq, cortex_piece p, int sign) {
+    if (!_cortex_eval_nnue_net || !p) return;
+
+    for (int view = 0; view < 2; ++view) {
+        int16_t* values = acc->values[view];
+        const int16_t* column = _cortex_eval_nnue_net->hidden_weights[_cortex_eval_nnue_feature(sq, p, view)];
+        int i = 0;
+
+#if defined(CORTEX_EVAL_NNUE_AVX2)
+        for (; i < CORTEX_EVAL_NNUE_HIDDEN; i += 16) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (values + i));
+            __m256i w = _mm256_loadu_si256((const __m256i*) (column + i));
+
+            v = (sign > 0) ? _mm256_add_epi16(v, w) : _mm256_sub_epi16(v, w);
+            _mm256_storeu_si256((__m256i*) (values + i), v);
+        }
+#elif defined(CORTEX_EVAL_NNUE_SSE2)
+        for (; i < CORTEX_EVAL_NNUE_HIDDEN; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (values + i));
+            __m128i w = _mm_loadu_si128((const __m128i*) (column + i));
+
+            v = (sign > 0) ? _mm_add_epi16(v, w) : _mm_sub_epi16(v, w);
+            _mm_storeu_si128((__m128i*) (values + i), v);
+        }
+#endif
+
+        for (; i < CORTEX_EVAL_NNUE_HIDDEN; ++i) {
+            values[i] += (sign > 0) ? column[i] : -column[i];
+        }
+    }
+}
+
+int32_t cortex_eval_nnue_evaluate(const cortex_eval_nnue_accumulator* acc, cortex_piece_color to_move) {
+    const cortex_eval_nnue_net* net = _cortex_eval_nnue_net;
+
+    /* The color to move's view comes first, so the network always sees the position from the mover's side. */
+    int16_t hidden[2 * CORTEX_EVAL_NNUE_HIDDEN];
+    _cortex_eval_nnue_clip(acc->values[to_move], hidden, CORTEX_EVAL_NNUE_HIDDEN);
+    _cortex_eval_nnue_clip(acc->values[!to_move], hidden + CORTEX_EVAL_NNUE_HIDDEN, CORTEX_EVAL_NNUE_HIDDEN);
+
+    int32_t output = net->output_bias;
+
+    for (int n = 0; n < CORTEX_EVAL_NNUE_L1; ++n) {
+        int32_t sum = (_cortex_eval_nnue_dot(hidden, net->l1_weights[n], 2 * CORTEX_EVAL_NNUE_HIDDEN) + net->l1_bias[n]) >> CORTEX_EVAL_NNUE_L1_SHIFT;
+
+        if (sum < 0) sum = 0;
+        if (sum > CORTEX_EVAL_NNUE_CLIP) sum = CORTEX_EVAL_NNUE_CLIP;
+
+        output += sum * net->output_weights[n];
+    }
+
+    return output / CORTEX_EVAL_NNUE_OUTPUT_SCALE;
+}
+
+/* Input number of a piece on a square, as seen by <view>: its own pieces first, and black sees the board flipped. */
+static int _cortex_eval_nnue_feature(cortex_square sq, cortex_piece p, cortex_piece_color view) {
+    int own = CORTEX_PIECE_GET_COLOR(p) == view;
+    if (view != CORTEX_PIECE_COLOR_WHITE) sq ^= 56;
+
+    return ((own ? 0 : 6) + CORTEX_PIECE_GET_TYPE(p) - 1) * 64 + sq;
+}
+
+/* Clipped ReLU. <len> is a multiple of 16. */
+static void _cortex_eval_nnue_clip(const int16_t* in, int16_t* out, int len) {
+    int i = 0;
+
+#if defined(CORTEX_EVAL_NNUE_AVX2)
+    __m256i zero = _mm256_setzero_si256(), clip = _mm256_set1_epi16(CORTEX_EVAL_NNUE_CLIP);
+
+    for (; i < len; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (in + i));
+        _mm256_storeu_si256((__m256i*) (out + i), _mm256_min_epi16(_mm256_max_epi16(v, zero), clip));
+    }
+#elif defined(CORTEX_EVAL_NNUE_SSE2)
+    __m128i zero = _mm_setzero_si128(), clip = _mm_set1_epi16(CORTEX_EVAL_NNUE_CLIP);
+
+    for (; i < len; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (in + i));
+        _mm_storeu_si128((__m128i*) (out + i), _mm_min_epi16(_mm_max_epi16(v, zero), clip));
+    }
+#endif
+
+    for (; i < len; ++i) {
+        out[i] = in[i] < 0 ? 0 : (in[i] > CORTEX_EVAL_NNUE_CLIP ? CORTEX_EVAL_NNUE_CLIP : in[i]);
+    }
+}
+
+/* Dot product of int16 vectors into int32. <len> is a multiple of 16. */
+static int32_t _cortex_eval_nnue_dot(const int16_t* a, const int16_t* b, int len) {
+    int32_t sum = 0;
+    int i = 0;
+
+#if defined(CORTEX_EVAL_NNUE_AVX2)
+    __m256i acc = _mm256_setzero_si256();
+
+    for (; i < len; i += 16) {
+        __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*) (b + i));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(half);
+#elif defined(CORTEX_EVAL_NNUE_SSE2)
+    __m128i acc = _mm_setzero_si128();
+
+    for (; i < len; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+    }
+
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(acc);
+#endif
+
+    for (; i < len; ++i) {
+        sum += a[i] * b[i];
+    }
+
+    return sum;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+ * Neural network evaluation (NNUE).
+ * 768 inputs, one per piece and square, feed a layer of HIDDEN neurons whose sums are kept in an
+ * accumulator on the board for each color's point of view. A move only adds and removes the columns
+ * of the pieces it touches. The side to move's half and the other half are clipped and run through a
+ * dense layer of L1 neurons, then a single output neuron.
+ *
+ * Networks are mapped straight from a file laid out as cortex_eval_nnue_net, little endian.
+ * The kernels use AVX2 or SSE2 when the compiler targets them. Build with -DCORTEX_EVAL_NNUE_SCALAR
+ * to force plain C.
+ */
+
+#include "piece.h"
+#include "square.h"
+
+#define CORTEX_EVAL_NNUE_INPUTS (64 * 12)
+#define CORTEX_EVAL_NNUE_HIDDEN 256
+#define CORTEX_EVAL_NNUE_L1 32
+
+/* Clipping ceiling of the hidden and L1 activations. */
+#define CORTEX_EVAL_NNUE_CLIP 127
+
+/* L1 sums are scaled down by this many bits before clipping. */
+#define CORTEX_EVAL_NNUE_L1_SHIFT 6
+
+/* The output neuron is divided by this to get centipawns. */
+#define CORTEX_EVAL_NNUE_OUTPUT_SCALE 64
+
+#define CORTEX_EVAL_NNUE_MAGIC "CXNN"
+#define CORTEX_EVAL_NNUE_VERSION 1
+
+typedef struct _cortex_eval_nnue_net {
+    char magic[4];
+    uint32_t version;
+    u8 reserved[56]; /* keeps the weights 64-byte aligned in the mapping */
+    int16_t hidden_bias[CORTEX_EVAL_NNUE_HIDDEN];
+    int16_t hidden_weights[CORTEX_EVAL_NNUE_INPUTS][CORTEX_EVAL_NNUE_HIDDEN];
+    int16_t l1_weights[CORTEX_EVAL_NNUE_L1][2 * CORTEX_EVAL_NNUE_HIDDEN];
+    int32_t l1_bias[CORTEX_EVAL_NNUE_L1];
+    int16_t output_weights[CORTEX_EVAL_NNUE_L1];
+    int32_t output_bias;
+} cortex_eval_nnue_net;
+
+/* Hidden layer sums, indexed by the color whose point of view they take. */
+typedef struct _cortex_eval_nnue_accumulator {
+    int16_t values[2][CORTEX_EVAL_NNUE_HIDDEN];
+} cortex_eval_nnue_accumulator;
+
+/*
+ * Map a network file. Boards set up before loading have stale accumulators until cortex_board_update_scores().
+ * Returns -1 if the file can't be mapped or isn't a network of this shape.
+ */
+int cortex_eval_nnue_load(const char* path);
+void cortex_eval_nnue_unload();
+
+/* Returns 1 if a network is loaded. */
+int cortex_eval_nnue_loaded();
+
+/* Reset an accumulator to the hidden biases. Does nothing without a network. */
+void cortex_eval_nnue_refresh(cortex_eval_nnue_accumulator* acc);
+
+/* Add (<sign> 1) or remove (-1) a piece on a square. Does nothing without a network. */
+void cortex_eval_nnue_update(cortex_eval_nnue_accumulator* acc, cortex_square sq, cortex_piece p, int sign);
+
+/* Evaluate an accumulator for the color to move, in centipawns. */
+int32_t cortex_eval_nnue_evaluate(const cortex_eval_nnue_accumulator* acc, cortex_piece_color to_move);
@@ -0,0 +1,225 @@
+#include "eval.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Proof-number search.
+ * Best-first search for a forced mate by the color to move, with no depth limit short of MAX_PLY.
+ * Nodes live in one arena allocated up front from the memory limit; children are allocated together
+ * so a node only needs the index of its first child. Boards are not stored, the search replays
+ * the moves from the root on every descent.
+ */
+
+#define CORTEX_EVAL_PN_INFINITY UINT32_MAX
+
+typedef struct _cortex_eval_pn_node {
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t proof, disproof;
+    u8 child_count;
+    u8 index; /* move number in the parent's legal move list */
+    u8 expanded;
+} cortex_eval_pn_node;
+
+typedef struct _cortex_eval_pn_tree {
+    cortex_eval_pn_node* nodes;
+    uint32_t len, size;
+    int horizon; /* some line was cut off at MAX_PLY, so a disproof only holds within it */
+} cortex_eval_pn_tree;
+
+static int _cortex_eval_pn_expand(cortex_eval_pn_tree* t, uint32_t n, cortex_board* b, int attacking, int ply);
+static void _cortex_eval_pn_update(cortex_eval_pn_tree* t, uint32_t n, int attacking);
+static uint32_t _cortex_eval_pn_select(cortex_eval_pn_tree* t, uint32_t n, int attacking);
+static uint32_t _cortex_eval_pn_add(uint32_t a, uint32_t b);
+
+int cortex_eval_pn(cortex_board* b, size_t memory, cortex_move* line, int* line_len) {
+    if (!b) return -1;
+
+    cortex_eval_pn_tree t;
+
+    t.size = memory / sizeof *t.nodes;
+    if (t.size > UINT32_MAX - 1) t.size = UINT32_MAX - 1;
+    if (t.size < 1) return -1;
+
+    t.nodes = malloc((size_t) t.size * sizeof *t.nodes);
+    if (!t.nodes) return -1;
+
+    cortex_eval_pn_node* root = t.nodes;
+    memset(root, 0, sizeof *root);
+    t.len = 1;
+    t.horizon = 0;
+
+    /* The root is an OR node: the attacker needs one move that works. */
+    if (!b->legal_moves.len) {
+        root->proof = CORTEX_EVAL_PN_INFINITY;
+        root->disproof = 0;
+    } else {
+        root->proof = 1;
+        root->disproof = b->legal_moves.len;
+    }
+
+    while (root->proof && root->disproof) {
+        /* Walk down to the most-proving node, replaying its moves. */
+        cortex_board pos;
+        memcpy(&pos, b, sizeof pos);
+
+        uint32_t n = 0;
+        int attacking = 1, ply = 0;
+
+        while (t.nodes[n].expanded) {
+            n = _cortex_eval_pn_select(&t, n, attacking);
+            cortex_board_apply_move(&pos, pos.legal_moves.list[t.nodes[n].index]);
+            attacking = !attacking;
+            ++ply;
+        }
+
+        /* Out of memory, the root stays unknown. */
+        if (_cortex_eval_pn_expand(&t, n, &pos, attacking, ply)) break;
+
+        /* Back the new numbers up to the root. */
+        for (;;) {
+            _cortex_eval_pn_update(&t, n, attacking);
+            if (!n) break;
+
+            n = t.nodes[n].parent;
+            attacking = !attacking;
+        }
+    }
+
+    int result = CORTEX_EVAL_PN_UNKNOWN;
+
+    if (!root->proof) {
+        result = CORTEX_EVAL_PN_PROVEN;
+    } else if (!root->disproof && !t.horizon) {
+        result = CORTEX_EVAL_PN_DISPROVEN;
+    }
+
+    /* The main line follows the same choices as the search: the proof, the refutation or the most-proving line. */
+    if (line && line_len) {
+        cortex_board pos;
+        memcpy(&pos, b, sizeof pos);
+
+        uint32_t n = 0;
+        int attacking = 1, len = 0;
+
+        while (t.nodes[n].child_count && len < CORTEX_EVAL_MAX_PLY) {
+            n = _cortex_eval_pn_select(&t, n, attacking);
+
+            cortex_move move = pos.legal_moves.list[t.nodes[n].index];
+            line[len++] = move;
+
+            if (t.nodes[n].child_count) cortex_board_apply_move(&pos, move);
+            attacking = !attacking;
+        }
+
+        *line_len = len;
+    }
+
+    free(t.nodes);
+    return result;
+}
+
+/*
+ * Allocate and evaluate the children of a node.
+ * Mates are solved at once from the move flags. Other children start with proof numbers counting
+ * the replies the side to move has, so narrow defences are tried first.
+ * Returns -1 if the arena is full.
+ */
+static int _cortex_eval_pn_expand(cortex_eval_pn_tree* t, uint32_t n, cortex_board* b, int attacking, int ply) {
+    int count = b->legal_moves.len;
+
+    if (t->size - t->len < (uint32_t) count) return -1;
+
+    cortex_eval_pn_node* node = t->nodes + n;
+
+    node->first_child = t->len;
+    node->child_count = count;
+    node->expanded = 1;
+    t->len += count;
+
+    for (int i = 0; i < count; ++i) {
+        cortex_eval_pn_node* child = t->nodes + node->first_child + i;
+        cortex_move move = b->legal_moves.list[i];
+
+        memset(child, 0, sizeof *child);
+        child->parent = n;
+        child->index = i;
+
+        /* Proof numbers are always from the attacker's side. A mate by the defender disproves the line. */
+        if (move.move_attr & CORTEX_MOVE_ATTR_MATE) {
+            child->proof = attacking ? 0 : CORTEX_EVAL_PN_INFINITY;
+            child->disproof = attacking ? CORTEX_EVAL_PN_INFINITY : 0;
+            continue;
+        }
+
+        /* Nothing past the horizon can be proven in this run. The search moves on, but a disproof is no longer final. */
+        if (ply + 1 >= CORTEX_EVAL_MAX_PLY) {
+            child->proof = CORTEX_EVAL_PN_INFINITY;
+            child->disproof = 0;
+            t->horizon = 1;
+            continue;
+        }
+
+        cortex_board tmp_board;
+        memcpy(&tmp_board, b, sizeof tmp_board);
+        cortex_board_apply_move(&tmp_board, move);
+
+        if (!tmp_board.legal_moves.len || cortex_board_is_draw(&tmp_board, 1)) {
+            /* Stalemate or a draw, mates were handled above. */
+            child->proof = CORTEX_EVAL_PN_INFINITY;
+            child->disproof = 0;
+        } else if (attacking) {
+            /* AND node, every defence has to be proven. */
+            child->proof = tmp_board.legal_moves.len;
+            child->disproof = 1;
+        } else {
+            child->proof = 1;
+            child->disproof = tmp_board.legal_moves.len;
+        }
+    }
+
+    return 0;
+}
+
+/* Recompute the numbers of an expanded node from its children. */
+static void _cortex_eval_pn_update(cortex_eval_pn_tree* t, uint32_t n, int attacking) {
+    cortex_eval_pn_node* node = t->nodes + n;
+    cortex_eval_pn_node* children = t->nodes + node->first_child;
+
+    uint32_t min = CORTEX_EVAL_PN_INFINITY, sum = 0;
+
+    for (int i = 0; i < node->child_count; ++i) {
+        uint32_t to_min = attacking ? children[i].proof : children[i].disproof;
+        uint32_t to_sum = attacking ? children[i].disproof : children[i].proof;
+
+        if (to_min < min) min = to_min;
+        sum = _cortex_eval_pn_add(sum, to_sum);
+    }
+
+    if (attacking) {
+        node->proof = min;
+        node->disproof = sum;
+    } else {
+        node->proof = sum;
+        node->disproof = min;
+    }
+}
+
+/* The child the attacker would prove first, or the defence easiest to refute. */
+static uint32_t _cortex_eval_pn_select(cortex_eval_pn_tree* t, uint32_t n, int attacking) {
+    cortex_eval_pn_node* node = t->nodes + n;
+    uint32_t best = node->first_child;
+
+    for (uint32_t c = node->first_child + 1; c < node->first_child + node->child_count; ++c) {
+        if (attacking ? t->nodes[c].proof < t->nodes[best].proof : t->nodes[c].disproof < t->nodes[best].disproof) {
+            best = c;
+        }
+    }
+
+    return best;
+}
+
+static uint32_t _cortex_eval_pn_add(uint32_t a, uint32_t b) {
+    return (a > CORTEX_EVAL_PN_INFINITY - b) ? CORTEX_EVAL_PN_INFINITY : a + b;
+}
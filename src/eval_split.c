@@ -0,0 +1,81 @@
+#include "eval_split.h"
+
+static int _cortex_eval_split_is_under(cortex_eval_split* sp, cortex_eval_split* ancestor);
+
+int cortex_eval_split_deque_init(cortex_eval_split_deque* dst) {
+    if (!dst) return -1;
+
+    dst->top = dst->bottom = 0;
+    return pthread_mutex_init(&dst->lock, NULL) ? -1 : 0;
+}
+
+int cortex_eval_split_deque_free(cortex_eval_split_deque* dst) {
+    pthread_mutex_lock(&dst->lock);
+    int out = CORTEX_EVAL_SPLIT_DEQUE_SIZE - dst->bottom;
+    pthread_mutex_unlock(&dst->lock);
+
+    return out;
+}
+
+int cortex_eval_split_push(cortex_eval_split_deque* dst, cortex_eval_split_task task) {
+    pthread_mutex_lock(&dst->lock);
+
+    if (dst->bottom == CORTEX_EVAL_SPLIT_DEQUE_SIZE) {
+        pthread_mutex_unlock(&dst->lock);
+        return -1;
+    }
+
+    dst->tasks[dst->bottom++] = task;
+
+    pthread_mutex_unlock(&dst->lock);
+    return 0;
+}
+
+int cortex_eval_split_pop(cortex_eval_split_deque* dst, cortex_eval_split* sp, cortex_eval_split_task* out) {
+    int found = 0;
+
+    pthread_mutex_lock(&dst->lock);
+
+    if (dst->bottom > dst->top && dst->tasks[dst->bottom - 1].sp == sp) {
+        *out = dst->tasks[--dst->bottom];
+        found = 1;
+    }
+
+    /* Rewind once empty so the space stolen from the top is reused. */
+    if (dst->bottom == dst->top) dst->bottom = dst->top = 0;
+
+    pthread_mutex_unlock(&dst->lock);
+    return found;
+}
+
+int cortex_eval_split_steal(cortex_eval_split_deque* dst, cortex_eval_split* within, cortex_eval_split_task* out) {
+    int found = 0;
+
+    pthread_mutex_lock(&dst->lock);
+
+    if (dst->bottom > dst->top && (!within || _cortex_eval_split_is_under(dst->tasks[dst->top].sp, within))) {
+        *out = dst->tasks[dst->top++];
+        found = 1;
+    }
+
+    if (dst->bottom == dst->top) dst->bottom = dst->top = 0;
+
+    pthread_mutex_unlock(&dst->lock);
+    return found;
+}
+
+int cortex_eval_split_is_cutoff(cortex_eval_split* sp) {
+    for (; sp; sp = sp->parent) {
+        if (__atomic_load_n(&sp->cutoff, __ATOMIC_RELAXED)) return 1;
+    }
+
+    return 0;
+}
+
+static int _cortex_eval_split_is_under(cortex_eval_split* sp, cortex_eval_split* ancestor) {
+    for (; sp; sp = sp->parent) {
+        if (sp == ancestor) return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+ * Split points for the work-stealing (YBWC) search.
+ * Once the first move of a node has been searched, the remaining moves are pushed as tasks onto the
+ * searching thread's deque. The owner pops tasks from the bottom, idle threads steal them from the top.
+ */
+
+#include "board.h"
+#include "eval.h"
+
+#include <pthread.h>
+
+#define CORTEX_EVAL_SPLIT_DEQUE_SIZE 4096
+
+/* Node attributes the move loop depends on. */
+#define CORTEX_EVAL_NODE_IN_CHECK 1
+#define CORTEX_EVAL_NODE_PV       2
+#define CORTEX_EVAL_NODE_FUTILE   4
+
+/* A node whose remaining moves are being searched in parallel. Lives on the owner's stack until every task is done. */
+typedef struct _cortex_eval_split {
+    pthread_mutex_t lock;
+    struct _cortex_eval_split* parent; /* split point the owner was working under, if any */
+    cortex_board* b;
+    cortex_move* moves; /* remaining moves in search order */
+    int first_index; /* move number of moves[0] at the node */
+    int depth, ply, flags;
+    cortex_score alpha, beta, best_score; /* shared window, guarded by lock */
+    cortex_move best_move;
+    int cutoff; /* set once a task fails high, the others abandon their search */
+    int pending; /* tasks not finished yet */
+} cortex_eval_split;
+
+typedef struct _cortex_eval_split_task {
+    cortex_eval_split* sp;
+    int index; /* into sp->moves */
+} cortex_eval_split_task;
+
+typedef struct _cortex_eval_split_deque {
+    pthread_mutex_t lock;
+    cortex_eval_split_task tasks[CORTEX_EVAL_SPLIT_DEQUE_SIZE];
+    int top, bottom;
+} cortex_eval_split_deque;
+
+int cortex_eval_split_deque_init(cortex_eval_split_deque* dst);
+
+/* Number of tasks that can still be pushed. */
+int cortex_eval_split_deque_free(cortex_eval_split_deque* dst);
+
+/* Push a task at the bottom. Only the owning thread pushes. Returns -1 if the deque is full. */
+int cortex_eval_split_push(cortex_eval_split_deque* dst, cortex_eval_split_task task);
+
+/* Pop the bottom task if it belongs to <sp>. Only the owning thread pops. Returns 1 if a task was taken. */
+int cortex_eval_split_pop(cortex_eval_split_deque* dst, cortex_eval_split* sp, cortex_eval_split_task* out);
+
+/*
+ * Steal the top task. If <within> is not NULL, the task is only taken if it belongs to <within> or a split point below it.
+ * Returns 1 if a task was taken.
+ */
+int cortex_eval_split_steal(cortex_eval_split_deque* dst, cortex_eval_split* within, cortex_eval_split_task* out);
+
+/* Returns nonzero if <sp> or any split point above it has been cut off. */
+int cortex_eval_split_is_cutoff(cortex_eval_split* sp);
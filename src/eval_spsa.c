@@ -0,0 +1,371 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "eval_spsa.h"
+#include "eval_cache.h"
+#include "eval_endgame.h"
+#include "clock.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Decay exponents of the learning rate and the perturbation steps. */
+#define CORTEX_EVAL_SPSA_ALPHA 0.602
+#define CORTEX_EVAL_SPSA_GAMMA 0.101
+
+/* One engine of a game, running in its own process so it keeps its own parameters and cache for the whole game. */
+typedef struct _cortex_eval_spsa_engine {
+    pid_t pid;
+    int to, from; /* pipes carrying requests to the engine and its moves back */
+} cortex_eval_spsa_engine;
+
+/* Sent to the engine to move: its clock, and the opponent's last move unless it moves first. */
+typedef struct _cortex_eval_spsa_request {
+    int clock_ms;
+    int has_move;
+    cortex_move move;
+} cortex_eval_spsa_request;
+
+/* Sent back by the engine: its move, or failed if it couldn't search or play one. */
+typedef struct _cortex_eval_spsa_reply {
+    int failed;
+    cortex_move move;
+} cortex_eval_spsa_reply;
+
+static int _cortex_eval_spsa_play_pair(const cortex_eval_spsa_config* config, const int* plus, const int* minus, uint64_t seed);
+static int _cortex_eval_spsa_game(const cortex_eval_spsa_config* config, cortex_board* opening, const int* white, const int* black);
+static int _cortex_eval_spsa_referee(const cortex_eval_spsa_config* config, cortex_board* opening, cortex_eval_spsa_engine* engines);
+static int _cortex_eval_spsa_engine_start(const cortex_eval_spsa_config* config, cortex_board* opening, const int* values, cortex_eval_spsa_engine* e);
+static void _cortex_eval_spsa_engine_run(const cortex_eval_spsa_config* config, cortex_board* opening, const int* values, int in, int out);
+static void _cortex_eval_spsa_engine_stop(cortex_eval_spsa_engine* e);
+static void _cortex_eval_spsa_apply(const int* values, cortex_board* b);
+
+void cortex_eval_spsa_defaults(cortex_eval_spsa_config* config) {
+    config->iterations = 1000;
+    config->workers = 1;
+    config->clock_ms = 0;
+    config->inc_ms = 0;
+    config->opening_plies = 8;
+    config->max_plies = 300;
+    config->rate = 0.1;
+    config->tuned = NULL;
+    config->seed = 0;
+}
+
+int cortex_eval_spsa_run(const cortex_eval_spsa_config* config, cortex_eval_spsa_callback cb, void* data) {
+    if (!config || config->iterations < 1) return -1;
+
+    int count = cortex_eval_param_count();
+    int workers = config->workers;
+
+    if (workers < 1) workers = 1;
+    if (workers > CORTEX_EVAL_MAX_THREADS) workers = CORTEX_EVAL_MAX_THREADS;
+
+    /* The perturbations and the openings both come from rand(). */
+    srand(config->seed ? config->seed : (unsigned) time(NULL));
+
+    /* Build the KPK bitbase here once, so the engine processes inherit it instead of each building their own. */
+    cortex_eval_endgame_kpk(0, 8, 63, CORTEX_PIECE_COLOR_WHITE);
+
+    double theta[count];
+    int step[count], min[count], max[count], tuned[count];
+
+    for (int i = 0; i < count; ++i) {
+        const char* name;
+        cortex_eval_param_info(i, &name, min + i, max + i, step + i);
+
+        theta[i] = cortex_eval_param_get(i);
+        tuned[i] = config->tuned ? config->tuned[i] : strcmp(name, "DEPTH") != 0;
+    }
+
+    /* The learning rate holds for the first tenth of the run before it starts to decay. */
+    double stability = config->iterations / 10.0;
+    double points = 0.0;
+    int done = 0;
+
+    int plus[workers][count], minus[workers][count], delta[workers][count];
+    int scores[workers];
+
+    while (done < config->iterations) {
+        int round = config->iterations - done;
+        if (round > workers) round = workers;
+
+        pid_t pids[round];
+        int fds[round];
+
+        for (int w = 0; w < round; ++w) {
+            double c = pow(done + w + 1, -CORTEX_EVAL_SPSA_GAMMA);
+
+            for (int i = 0; i < count; ++i) {
+                delta[w][i] = tuned[i] ? ((rand() & 1) ? 1 : -1) : 0;
+
+                plus[w][i] = (int) lround(theta[i] + c * step[i] * delta[w][i]);
+                minus[w][i] = (int) lround(theta[i] - c * step[i] * delta[w][i]);
+            }
+
+            uint64_t seed = ((uint64_t) rand() << 32) ^ (uint64_t) rand();
+            int fd[2];
+
+            pids[w] = -1;
+
+            if (!pipe(fd)) {
+                pids[w] = fork();
+
+                if (!pids[w]) {
+                    close(fd[0]);
+
+                    u8 score = _cortex_eval_spsa_play_pair(config, plus[w], minus[w], seed);
+                    _exit(write(fd[1], &score, 1) != 1);
+                }
+
+                close(fd[1]);
+                fds[w] = fd[0];
+
+                if (pids[w] < 0) close(fd[0]);
+            }
+
+            /* Play here any pair a worker couldn't be started for. */
+            if (pids[w] < 0) scores[w] = _cortex_eval_spsa_play_pair(config, plus[w], minus[w], seed);
+        }
+
+        for (int w = 0; w < round; ++w) {
+            if (pids[w] < 0) continue;
+
+            /* A worker that died without a result counts as a drawn pair. */
+            u8 score = 2;
+            if (read(fds[w], &score, 1) != 1) score = 2;
+
+            close(fds[w]);
+            waitpid(pids[w], NULL, 0);
+
+            scores[w] = score;
+        }
+
+        for (int w = 0; w < round; ++w) {
+            int k = done + w + 1;
+            double a = config->rate * pow((stability + 1) / (stability + k), CORTEX_EVAL_SPSA_ALPHA);
+            double c = pow(k, -CORTEX_EVAL_SPSA_GAMMA);
+
+            /* +1 if the plus engine won both games, -1 if the minus engine did. */
+            double result = (scores[w] - 2) / 2.0;
+
+            for (int i = 0; i < count; ++i) {
+                theta[i] += a * c * step[i] * result * delta[w][i];
+
+                if (theta[i] < min[i]) theta[i] = min[i];
+                if (theta[i] > max[i]) theta[i] = max[i];
+            }
+
+            points += scores[w] / 2.0;
+        }
+
+        done += round;
+        if (cb) cb(done, points / (2.0 * done), data);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        cortex_eval_param_set(i, (int) lround(theta[i]));
+    }
+
+    return 0;
+}
+
+int cortex_eval_spsa_save(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+
+    for (int i = 0; i < cortex_eval_param_count(); ++i) {
+        const char* name;
+        cortex_eval_param_info(i, &name, NULL, NULL, NULL);
+
+        fprintf(f, "%s %d\n", name, cortex_eval_param_get(i));
+    }
+
+    return fclose(f) ? -1 : 0;
+}
+
+int cortex_eval_spsa_load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+
+    char name[64];
+    int value;
+
+    while (fscanf(f, "%63s %d", name, &value) == 2) {
+        int i = cortex_eval_param_find(name);
+        if (i >= 0) cortex_eval_param_set(i, value);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/* Play a random opening, then a game with each engine as white. Returns the half points of <plus>, 0 to 4. */
+static int _cortex_eval_spsa_play_pair(const cortex_eval_spsa_config* config, const int* plus, const int* minus, uint64_t seed) {
+    cortex_board opening;
+    cortex_board_init(&opening);
+
+    for (int i = 0; i < config->opening_plies && opening.legal_moves.len; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        cortex_board_apply_move(&opening, opening.legal_moves.list[(seed >> 33) % opening.legal_moves.len]);
+    }
+
+    int score = _cortex_eval_spsa_game(config, &opening, plus, minus);
+    score += 2 - _cortex_eval_spsa_game(config, &opening, minus, plus);
+
+    return score;
+}
+
+/*
+ * Play a game from <opening> with the parameters of each color. Returns white's half points.
+ * A game whose engines can't be started is a draw.
+ */
+static int _cortex_eval_spsa_game(const cortex_eval_spsa_config* config, cortex_board* opening, const int* white, const int* black) {
+    cortex_eval_spsa_engine engines[2];
+
+    if (_cortex_eval_spsa_engine_start(config, opening, black, &engines[CORTEX_PIECE_COLOR_BLACK])) return 1;
+
+    if (_cortex_eval_spsa_engine_start(config, opening, white, &engines[CORTEX_PIECE_COLOR_WHITE])) {
+        _cortex_eval_spsa_engine_stop(&engines[CORTEX_PIECE_COLOR_BLACK]);
+        return 1;
+    }
+
+    int score = _cortex_eval_spsa_referee(config, opening, engines);
+
+    _cortex_eval_spsa_engine_stop(&engines[CORTEX_PIECE_COLOR_WHITE]);
+    _cortex_eval_spsa_engine_stop(&engines[CORTEX_PIECE_COLOR_BLACK]);
+
+    return score;
+}
+
+/* Keep the board and the clocks while the engines take turns. Returns white's half points. */
+static int _cortex_eval_spsa_referee(const cortex_eval_spsa_config* config, cortex_board* opening, cortex_eval_spsa_engine* engines) {
+    cortex_board b;
+    memcpy(&b, opening, sizeof b);
+
+    int clock_ms[2] = { config->clock_ms, config->clock_ms };
+    cortex_eval_spsa_request request = { 0 };
+
+    for (int ply = 0; ply < config->max_plies; ++ply) {
+        if (!b.legal_moves.len) {
+            if (!cortex_eval_in_check(&b)) return 1;
+            return (b.color_to_move == CORTEX_PIECE_COLOR_WHITE) ? 0 : 2;
+        }
+
+        if (cortex_board_is_draw(&b, 2)) return 1;
+
+        int col = b.color_to_move;
+        uint64_t start_ms = cortex_clock_ms();
+
+        request.clock_ms = clock_ms[col];
+
+        /* An engine that can't search or play a move ends the game as a draw. */
+        cortex_eval_spsa_reply reply;
+
+        if (write(engines[col].to, &request, sizeof request) != sizeof request) return 1;
+        if (read(engines[col].from, &reply, sizeof reply) != sizeof reply || reply.failed) return 1;
+
+        /* No time forfeits. A side out of time plays on with the smallest clock. */
+        if (config->clock_ms) {
+            clock_ms[col] -= cortex_clock_ms() - start_ms;
+            if (clock_ms[col] < 1) clock_ms[col] = 1;
+
+            clock_ms[col] += config->inc_ms;
+        }
+
+        if (cortex_board_apply_move(&b, reply.move)) return 1;
+
+        /* The other engine hears of the move when it is asked for its own. */
+        request.has_move = 1;
+        request.move = reply.move;
+    }
+
+    return 1;
+}
+
+/* Fork an engine with <values> for its parameters, playing from <opening>. Returns -1 on error. */
+static int _cortex_eval_spsa_engine_start(const cortex_eval_spsa_config* config, cortex_board* opening, const int* values, cortex_eval_spsa_engine* e) {
+    int to[2], from[2];
+
+    if (pipe(to)) return -1;
+
+    if (pipe(from)) {
+        close(to[0]);
+        close(to[1]);
+        return -1;
+    }
+
+    e->pid = fork();
+
+    if (!e->pid) {
+        close(to[1]);
+        close(from[0]);
+
+        _cortex_eval_spsa_engine_run(config, opening, values, to[0], from[1]);
+        _exit(0);
+    }
+
+    close(to[0]);
+    close(from[1]);
+
+    e->to = to[1];
+    e->from = from[0];
+
+    if (e->pid < 0) {
+        close(e->to);
+        close(e->from);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * The engine process. Its parameters are set and its cache cleared once, then the cache carries over from move to move
+ * like it would in a real game. It plays until the referee closes the request pipe.
+ */
+static void _cortex_eval_spsa_engine_run(const cortex_eval_spsa_config* config, cortex_board* opening, const int* values, int in, int out) {
+    cortex_board b;
+    memcpy(&b, opening, sizeof b);
+
+    _cortex_eval_spsa_apply(values, &b);
+
+    cortex_eval_spsa_request request;
+
+    while (read(in, &request, sizeof request) == sizeof request) {
+        cortex_eval_spsa_reply reply = { 1 };
+
+        if (!request.has_move || !cortex_board_apply_move(&b, request.move)) {
+            cortex_eval_set_clock(request.clock_ms, config->inc_ms, 0);
+
+            if (!cortex_eval_position(&b, &reply.move, NULL) && !cortex_board_apply_move(&b, reply.move)) {
+                reply.failed = 0;
+            }
+        }
+
+        if (write(out, &reply, sizeof reply) != sizeof reply) break;
+    }
+}
+
+/* Close the engine's requests, which ends it, and wait for it. */
+static void _cortex_eval_spsa_engine_stop(cortex_eval_spsa_engine* e) {
+    close(e->to);
+    close(e->from);
+    waitpid(e->pid, NULL, 0);
+}
+
+/* Switch an engine's process to its parameters. */
+static void _cortex_eval_spsa_apply(const int* values, cortex_board* b) {
+    for (int i = 0; i < cortex_eval_param_count(); ++i) {
+        cortex_eval_param_set(i, values[i]);
+    }
+
+    /* The board's scores were found with the default parameters, and the cache may hold the parent's results. */
+    cortex_board_update_scores(b);
+    cortex_eval_cache_clear();
+}
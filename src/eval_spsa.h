@@ -0,0 +1,42 @@
+#pragma once
+
+/*
+ * SPSA tuning of the named parameters (cortex_eval_param_*) by self-play.
+ * Iteration k moves every tuned parameter up or down at random by c_k * step, with delta = +1 or -1 its direction.
+ * The two engines this makes play a pair of games from the same opening, one with each color. With result +1 if the
+ * plus engine won both games, -1 if the minus engine did and in between otherwise, every parameter then moves by
+ * a_k * c_k * step * result * delta: toward the engine that scored better, by a fraction a_k of its perturbation.
+ * c_k = k^-0.101, and a_k = rate * ((A + 1) / (A + k))^0.602 with A a tenth of the iterations.
+ *
+ * The search state is global, so each game pair is played in a forked worker process. It forks one engine process
+ * per side for each game, so each engine searches with its own parameters and keeps its own cache from move to move.
+ * <workers> iterations are played at once and their updates applied together.
+ */
+
+#include "eval.h"
+
+typedef struct _cortex_eval_spsa_config {
+    int iterations; /* game pairs to play */
+    int workers; /* game pairs played at once, about one per core */
+    int clock_ms, inc_ms; /* each side's clock per game, or 0 for searches to the DEPTH parameter */
+    int opening_plies; /* random moves from the start position before each pair */
+    int max_plies; /* longer games are drawn */
+    double rate; /* initial learning rate, in steps per decisive game pair */
+    const int* tuned; /* nonzero for each parameter to tune, or NULL for all but DEPTH, which the deeper engine always wins */
+    unsigned seed; /* seed for the perturbations and openings, or 0 to seed from the time */
+} cortex_eval_spsa_config;
+
+/* Fill in the defaults. */
+void cortex_eval_spsa_defaults(cortex_eval_spsa_config* config);
+
+/* Called after each round of <workers> iterations with the number of iterations done and the score of the plus engines so far. */
+typedef void (*cortex_eval_spsa_callback)(int iterations, double score, void* data);
+
+/* Run a tuning session. Leaves the tuned values in the parameters. Returns -1 on error. */
+int cortex_eval_spsa_run(const cortex_eval_spsa_config* config, cortex_eval_spsa_callback cb, void* data);
+
+/* Write every parameter as a "NAME value" line. Returns -1 on error. */
+int cortex_eval_spsa_save(const char* path);
+
+/* Set parameters from "NAME value" lines. Unknown names are skipped. Returns -1 if the file can't be read. */
+int cortex_eval_spsa_load(const char* path);
@@ -0,0 +1,76 @@
+#include "eval_time.h"
+
+void cortex_eval_time_init(cortex_eval_time* tm, int time_ms, int inc_ms, int moves_to_go, uint64_t now) {
+    int moves = moves_to_go > 0 ? moves_to_go : CORTEX_EVAL_TIME_MOVES;
+    int available = time_ms - CORTEX_EVAL_TIME_OVERHEAD;
+
+    if (available < 1) available = 1;
+
+    uint64_t optimum = available / moves + inc_ms * 3 / 4;
+    uint64_t maximum = optimum * CORTEX_EVAL_TIME_MAX_RATIO;
+
+    /* Never plan on more than the clock has, the maximum leaves something for the moves after. */
+    if (maximum > (uint64_t) available / 2) maximum = available / 2;
+    if (optimum > maximum) optimum = maximum;
+
+    tm->optimum_ms = optimum;
+    tm->maximum_ms = maximum;
+    tm->instability = 1.0f;
+    tm->last_iteration_nodes = 0;
+    tm->iteration_nodes_start = 0;
+    tm->last_score = 0;
+    tm->iterations = 0;
+
+    cortex_eval_time_restart(tm, now);
+}
+
+void cortex_eval_time_restart(cortex_eval_time* tm, uint64_t now) {
+    tm->start_ms = now;
+    tm->iteration_start_ms = now;
+}
+
+int cortex_eval_time_next(cortex_eval_time* tm, cortex_move best_move, cortex_score score, uint64_t nodes, uint64_t now) {
+    uint64_t elapsed = now - tm->start_ms;
+    uint64_t iteration_ms = now - tm->iteration_start_ms;
+    uint64_t iteration_nodes = nodes - tm->iteration_nodes_start;
+
+    /* Instability fades, and comes back when the best move changes or the score drops. */
+    tm->instability = 1.0f + (tm->instability - 1.0f) * 0.5f;
+
+    if (tm->iterations) {
+        if (best_move.from != tm->last_move.from || best_move.to != tm->last_move.to || best_move.promote_type != tm->last_move.promote_type) {
+            tm->instability += 0.5f;
+        }
+
+        if (score <= tm->last_score - CORTEX_EVAL_TIME_SCORE_DROP) tm->instability += 0.3f;
+        if (tm->instability > 2.5f) tm->instability = 2.5f;
+    }
+
+    /* Effective branching factor: how many times larger each iteration's tree is than the last. */
+    float ebf = 2.0f;
+
+    if (tm->last_iteration_nodes && iteration_nodes) {
+        ebf = (float) iteration_nodes / tm->last_iteration_nodes;
+        if (ebf < 1.5f) ebf = 1.5f;
+        if (ebf > 8.0f) ebf = 8.0f;
+    }
+
+    uint64_t predicted = (uint64_t) (iteration_ms * ebf);
+    uint64_t allowed = (uint64_t) (tm->optimum_ms * tm->instability);
+
+    if (allowed > tm->maximum_ms) allowed = tm->maximum_ms;
+
+    tm->last_iteration_nodes = iteration_nodes;
+    tm->last_move = best_move;
+    tm->last_score = score;
+    tm->iterations++;
+
+    tm->iteration_start_ms = now;
+    tm->iteration_nodes_start = nodes;
+
+    return elapsed + predicted <= allowed;
+}
+
+int cortex_eval_time_up(cortex_eval_time* tm, uint64_t now) {
+    return now - tm->start_ms >= tm->maximum_ms;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+ * Search time management.
+ * A move gets an optimum time it should usually stay within and a maximum it must never exceed.
+ * After each iteration the next one's time is predicted from the effective branching factor, and
+ * it is only started if it can finish within the optimum, stretched while the best move or score
+ * is unstable. The maximum stops the search in the middle of an iteration.
+ */
+
+#include "eval.h"
+
+/* Moves the remaining time is spread over if the number until the next time control is not known. */
+#define CORTEX_EVAL_TIME_MOVES 30
+
+/* Time kept back for the overhead of making the move, in milliseconds. */
+#define CORTEX_EVAL_TIME_OVERHEAD 20
+
+/* The maximum time is at most this many times the optimum. */
+#define CORTEX_EVAL_TIME_MAX_RATIO 4
+
+/* A score falling by this much between iterations counts as unstable. */
+#define CORTEX_EVAL_TIME_SCORE_DROP 30
+
+typedef struct _cortex_eval_time {
+    uint64_t start_ms;
+    uint64_t optimum_ms, maximum_ms;
+    uint64_t iteration_start_ms, iteration_nodes_start;
+    uint64_t last_iteration_nodes;
+    float instability; /* optimum time multiplier, 1 when the search is stable */
+    cortex_move last_move;
+    cortex_score last_score;
+    int iterations;
+} cortex_eval_time;
+
+/* Budget a search from the remaining clock time, increment and moves to go (0 if unknown). */
+void cortex_eval_time_init(cortex_eval_time* tm, int time_ms, int inc_ms, int moves_to_go, uint64_t now);
+
+/* Restart the clock, keeping the budget. Used when a ponder turns into the real search. */
+void cortex_eval_time_restart(cortex_eval_time* tm, uint64_t now);
+
+/*
+ * Record a completed iteration with its best move, score and the total nodes searched so far.
+ * Returns 1 if the next iteration is expected to finish in time.
+ */
+int cortex_eval_time_next(cortex_eval_time* tm, cortex_move best_move, cortex_score score, uint64_t nodes, uint64_t now);
+
+/* Returns 1 once the maximum time is used up. */
+int cortex_eval_time_up(cortex_eval_time* tm, uint64_t now);
@@ -0,0 +1,476 @@
+#include "eval_tune.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Longest line read from a position file. */
+#define CORTEX_EVAL_TUNE_LINE 256
+
+/* Capture searches resolving a position go no deeper than this. */
+#define CORTEX_EVAL_TUNE_MAX_PLY 32
+
+/* Captures that can't bring the score within this of alpha aren't searched. */
+#define CORTEX_EVAL_TUNE_DELTA 200
+
+/* Adam decay rates. */
+#define CORTEX_EVAL_TUNE_BETA1 0.9
+#define CORTEX_EVAL_TUNE_BETA2 0.999
+
+#define CORTEX_EVAL_TUNE_LN10 2.302585092994046
+
+typedef struct _cortex_eval_tune_load_job {
+    char (*lines)[CORTEX_EVAL_TUNE_LINE];
+    cortex_eval_tune_position* out;
+    u8* valid;
+    size_t begin, end;
+} cortex_eval_tune_load_job;
+
+typedef struct _cortex_eval_tune_job {
+    const cortex_eval_tune_set* set;
+    const double* weights; /* midgame and endgame of each weight, interleaved */
+    size_t begin, end;
+    int gradient; /* also sum the gradient, unscaled */
+    double loss;
+    double grad[2 * CORTEX_EVAL_WEIGHT_COUNT];
+} cortex_eval_tune_job;
+
+static void _cortex_eval_tune_parallel(void* (*fn)(void*), void* jobs, size_t job_size, int count);
+static void _cortex_eval_tune_share(size_t total, int threads, int i, size_t* begin, size_t* end);
+static void* _cortex_eval_tune_load_main(void* arg);
+static int _cortex_eval_tune_resolve(const char* line, cortex_eval_tune_position* out);
+static int _cortex_eval_tune_result(const char* s);
+static cortex_score _cortex_eval_tune_quiesce(cortex_board* b, int ply, cortex_score alpha, cortex_score beta, cortex_piece* leaf);
+static double _cortex_eval_tune_pass(cortex_eval_tune_set* set, const double* weights, int threads, double* grad);
+static void* _cortex_eval_tune_main(void* arg);
+static void _cortex_eval_tune_get_weights(double* weights);
+
+long cortex_eval_tune_load(cortex_eval_tune_set* set, const char* path, int threads) {
+    if (!set || !path) return -1;
+
+    if (threads < 1) threads = 1;
+    if (threads > CORTEX_EVAL_MAX_THREADS) threads = CORTEX_EVAL_MAX_THREADS;
+
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+
+    char (*lines)[CORTEX_EVAL_TUNE_LINE] = malloc(CORTEX_EVAL_TUNE_CHUNK * sizeof *lines);
+    cortex_eval_tune_position* out = malloc(CORTEX_EVAL_TUNE_CHUNK * sizeof *out);
+    u8* valid = malloc(CORTEX_EVAL_TUNE_CHUNK);
+    long added = -1;
+
+    if (!lines || !out || !valid) goto done;
+
+    added = 0;
+
+    while (1) {
+        size_t n = 0;
+        while (n < CORTEX_EVAL_TUNE_CHUNK && fgets(lines[n], CORTEX_EVAL_TUNE_LINE, f)) ++n;
+
+        if (!n) break;
+
+        cortex_eval_tune_load_job jobs[CORTEX_EVAL_MAX_THREADS];
+
+        for (int i = 0; i < threads; ++i) {
+            jobs[i].lines = lines;
+            jobs[i].out = out;
+            jobs[i].valid = valid;
+            _cortex_eval_tune_share(n, threads, i, &jobs[i].begin, &jobs[i].end);
+        }
+
+        _cortex_eval_tune_parallel(_cortex_eval_tune_load_main, jobs, sizeof *jobs, threads);
+
+        if (set->count + n > set->capacity) {
+            size_t capacity = set->capacity ? set->capacity : CORTEX_EVAL_TUNE_CHUNK;
+            while (capacity < set->count + n) capacity *= 2;
+
+            cortex_eval_tune_position* grown = realloc(set->positions, capacity * sizeof *grown);
+
+            if (!grown) {
+                added = -1;
+                break;
+            }
+
+            set->positions = grown;
+            set->capacity = capacity;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            if (!valid[i]) continue;
+
+            set->positions[set->count++] = out[i];
+            ++added;
+        }
+
+        if (n < CORTEX_EVAL_TUNE_CHUNK) break;
+    }
+
+done:
+    free(lines);
+    free(out);
+    free(valid);
+    fclose(f);
+
+    return added;
+}
+
+void cortex_eval_tune_free(cortex_eval_tune_set* set) {
+    free(set->positions);
+    memset(set, 0, sizeof *set);
+}
+
+double cortex_eval_tune_loss(cortex_eval_tune_set* set, int threads) {
+    double weights[2 * CORTEX_EVAL_WEIGHT_COUNT];
+    _cortex_eval_tune_get_weights(weights);
+
+    return _cortex_eval_tune_pass(set, weights, threads, NULL);
+}
+
+double cortex_eval_tune_fit(cortex_eval_tune_set* set, int threads) {
+    double weights[2 * CORTEX_EVAL_WEIGHT_COUNT];
+    _cortex_eval_tune_get_weights(weights);
+
+    /* Golden section search. The loss has a single minimum in k. */
+    const double ratio = 0.6180339887498949;
+    double lo = 0.05, hi = 5.0;
+
+    double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+    set->k = a;
+    double loss_a = _cortex_eval_tune_pass(set, weights, threads, NULL);
+    set->k = b;
+    double loss_b = _cortex_eval_tune_pass(set, weights, threads, NULL);
+
+    for (int i = 0; i < 40; ++i) {
+        if (loss_a < loss_b) {
+            hi = b;
+            b = a;
+            loss_b = loss_a;
+            a = hi - ratio * (hi - lo);
+            set->k = a;
+            loss_a = _cortex_eval_tune_pass(set, weights, threads, NULL);
+        } else {
+            lo = a;
+            a = b;
+            loss_a = loss_b;
+            b = lo + ratio * (hi - lo);
+            set->k = b;
+            loss_b = _cortex_eval_tune_pass(set, weights, threads, NULL);
+        }
+    }
+
+    set->k = (loss_a < loss_b) ? a : b;
+    return (loss_a < loss_b) ? loss_a : loss_b;
+}
+
+int cortex_eval_tune_run(cortex_eval_tune_set* set, int epochs, double rate, int threads, cortex_eval_tune_callback cb, void* data) {
+    if (!set || !set->count || !set->k) return -1;
+
+    double weights[2 * CORTEX_EVAL_WEIGHT_COUNT];
+    double grad[2 * CORTEX_EVAL_WEIGHT_COUNT];
+    double m[2 * CORTEX_EVAL_WEIGHT_COUNT] = { 0 }, v[2 * CORTEX_EVAL_WEIGHT_COUNT] = { 0 };
+    double decay1 = 1.0, decay2 = 1.0;
+
+    _cortex_eval_tune_get_weights(weights);
+
+    for (int epoch = 1; epoch <= epochs; ++epoch) {
+        double loss = _cortex_eval_tune_pass(set, weights, threads, grad);
+
+        decay1 *= CORTEX_EVAL_TUNE_BETA1;
+        decay2 *= CORTEX_EVAL_TUNE_BETA2;
+
+        for (int i = 0; i < 2 * CORTEX_EVAL_WEIGHT_COUNT; ++i) {
+            m[i] = CORTEX_EVAL_TUNE_BETA1 * m[i] + (1.0 - CORTEX_EVAL_TUNE_BETA1) * grad[i];
+            v[i] = CORTEX_EVAL_TUNE_BETA2 * v[i] + (1.0 - CORTEX_EVAL_TUNE_BETA2) * grad[i] * grad[i];
+
+            weights[i] -= rate * (m[i] / (1.0 - decay1)) / (sqrt(v[i] / (1.0 - decay2)) + 1e-12);
+
+            if (weights[i] > CORTEX_EVAL_WEIGHT_LIMIT) weights[i] = CORTEX_EVAL_WEIGHT_LIMIT;
+            if (weights[i] < -CORTEX_EVAL_WEIGHT_LIMIT) weights[i] = -CORTEX_EVAL_WEIGHT_LIMIT;
+        }
+
+        if (cb) cb(epoch, loss, data);
+    }
+
+    for (int i = 0; i < CORTEX_EVAL_WEIGHT_COUNT; ++i) {
+        cortex_eval_weights[i] = CORTEX_EVAL_PAIR((int) lround(weights[2 * i]), (int) lround(weights[2 * i + 1]));
+    }
+
+    return 0;
+}
+
+int cortex_eval_tune_write(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+
+    fprintf(f, "#pragma once\n\n");
+    fprintf(f, "/*\n * Evaluation weights: name, midgame and endgame centipawns.\n * Generated by cortex -tune. Rewritten in full by each tuning run.\n */\n\n");
+    fprintf(f, "#define CORTEX_EVAL_WEIGHTS(W)");
+
+    for (int i = 0; i < CORTEX_EVAL_WEIGHT_COUNT; ++i) {
+        cortex_eval_pair w = cortex_eval_weights[i];
+        fprintf(f, " \\\n    W(%s, %d, %d)", cortex_eval_weight_names[i], CORTEX_EVAL_PAIR_MG(w), CORTEX_EVAL_PAIR_EG(w));
+    }
+
+    fprintf(f, "\n");
+
+    return fclose(f) ? -1 : 0;
+}
+
+/* Run <fn> on each of <count> jobs, one thread each. The calling thread takes the first, and any a thread couldn't be started for. */
+static void _cortex_eval_tune_parallel(void* (*fn)(void*), void* jobs, size_t job_size, int count) {
+    pthread_t handles[CORTEX_EVAL_MAX_THREADS];
+    int started[CORTEX_EVAL_MAX_THREADS];
+
+    for (int i = 0; i < count; ++i) {
+        started[i] = i && !pthread_create(handles + i, NULL, fn, (char*) jobs + i * job_size);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (!started[i]) fn((char*) jobs + i * job_size);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (started[i]) pthread_join(handles[i], NULL);
+    }
+}
+
+/* Thread <i>'s share of <total> items. */
+static void _cortex_eval_tune_share(size_t total, int threads, int i, size_t* begin, size_t* end) {
+    size_t per_thread = (total + threads - 1) / threads;
+
+    *begin = i * per_thread;
+    *end = *begin + per_thread;
+
+    if (*begin > total) *begin = total;
+    if (*end > total) *end = total;
+}
+
+static void* _cortex_eval_tune_load_main(void* arg) {
+    cortex_eval_tune_load_job* job = arg;
+
+    for (size_t i = job->begin; i < job->end; ++i) {
+        job->valid[i] = !_cortex_eval_tune_resolve(job->lines[i], job->out + i);
+    }
+
+    return NULL;
+}
+
+/* Parse and resolve one line of a position file. Returns -1 if the position is skipped. */
+static int _cortex_eval_tune_resolve(const char* line, cortex_eval_tune_position* out) {
+    /* The result is looked for after the placement, which can contain "1/2". */
+    const char* fields = strchr(line, ' ');
+    if (!fields) return -1;
+
+    int result = _cortex_eval_tune_result(fields);
+    if (result < 0) return -1;
+
+    cortex_board b;
+    if (cortex_board_set_fen(&b, line) || !b.legal_moves.len || cortex_eval_in_check(&b)) return -1;
+
+    cortex_piece leaf[64];
+    _cortex_eval_tune_quiesce(&b, 0, -CORTEX_SCORE_INFINITY, CORTEX_SCORE_INFINITY, leaf);
+
+    /* The features only need the placement and its attack sets. */
+    memcpy(b.state, leaf, sizeof b.state);
+    cortex_board_update_attacks(&b);
+
+    int32_t counts[CORTEX_EVAL_WEIGHT_COUNT];
+    cortex_eval_features(&b, counts);
+
+    for (int i = 0; i < CORTEX_EVAL_WEIGHT_COUNT; ++i) {
+        if (counts[i] < INT8_MIN || counts[i] > INT8_MAX) return -1;
+        out->counts[i] = counts[i];
+    }
+
+    int phase = 0;
+
+    for (int sq = 0; sq < 64; ++sq) {
+        phase += cortex_eval_piece_phase(leaf[sq]);
+    }
+
+    out->phase = phase < CORTEX_EVAL_PHASE_MAX ? phase : CORTEX_EVAL_PHASE_MAX;
+    out->result = result;
+
+    return 0;
+}
+
+/* Half points scored by white, from the text after a FEN's placement. -1 if there is no result. */
+static int _cortex_eval_tune_result(const char* s) {
+    const char* bracket = strchr(s, '[');
+
+    if (bracket) {
+        char* end;
+        double r = strtod(bracket + 1, &end);
+
+        if (end == bracket + 1) return -1;
+        return (r < 0.25) ? 0 : (r > 0.75) ? 2 : 1;
+    }
+
+    if (strstr(s, "1/2")) return 1;
+    if (strstr(s, "1-0")) return 2;
+    if (strstr(s, "0-1")) return 0;
+
+    return -1;
+}
+
+/*
+ * Capture search with the handcrafted evaluation, from the color to move's side. Losing and hopeless captures are skipped,
+ * and positions in check search all their evasions.
+ * The placement the best line ends in goes to <leaf>.
+ */
+static cortex_score _cortex_eval_tune_quiesce(cortex_board* b, int ply, cortex_score alpha, cortex_score beta, cortex_piece* leaf) {
+    cortex_score best_score = cortex_eval_taper(b->phase, b->psq + cortex_eval_positional(b));
+    if (b->color_to_move != CORTEX_PIECE_COLOR_WHITE) best_score = -best_score;
+
+    memcpy(leaf, b->state, sizeof b->state);
+
+    /* In check there is no standing pat, every evasion is searched. */
+    int in_check = cortex_eval_in_check(b);
+
+    if (!b->legal_moves.len) return in_check ? -CORTEX_SCORE_MATE + ply : best_score;
+    if (ply >= CORTEX_EVAL_TUNE_MAX_PLY) return best_score;
+
+    if (in_check) {
+        best_score = -CORTEX_SCORE_MATE + ply;
+    } else if (best_score >= beta) {
+        return best_score;
+    }
+
+    if (best_score > alpha) alpha = best_score;
+
+    int order[b->legal_moves.len];
+    cortex_score order_score[b->legal_moves.len];
+    int count = 0;
+
+    for (int i = 0; i < b->legal_moves.len; ++i) {
+        cortex_move move = b->legal_moves.list[i];
+
+        if (in_check) {
+            order[count] = i;
+            order_score[count++] = (move.move_type == CORTEX_MOVE_TYPE_CAPTURE) ? cortex_eval_see(b, move) : 0;
+            continue;
+        }
+
+        if (move.move_type != CORTEX_MOVE_TYPE_CAPTURE && !(move.move_attr & CORTEX_MOVE_ATTR_PROMOTE)) continue;
+
+        /* Delta pruning: skip captures that can't raise the score to alpha even with a margin for the position. */
+        cortex_score see = cortex_eval_see(b, move);
+        if (see < 0 || best_score + see + CORTEX_EVAL_TUNE_DELTA <= alpha) continue;
+
+        order[count] = i;
+        order_score[count++] = see;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        for (int j = i + 1; j < count; ++j) {
+            if (order_score[j] > order_score[i]) {
+                int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+                cortex_score tmp_score = order_score[i]; order_score[i] = order_score[j]; order_score[j] = tmp_score;
+            }
+        }
+
+        cortex_board child;
+        memcpy(&child, b, sizeof child);
+        cortex_board_apply_move(&child, b->legal_moves.list[order[i]]);
+
+        cortex_piece child_leaf[64];
+        cortex_score score = -_cortex_eval_tune_quiesce(&child, ply + 1, -beta, -alpha, child_leaf);
+
+        if (score > best_score) {
+            best_score = score;
+            memcpy(leaf, child_leaf, sizeof child_leaf);
+        }
+
+        if (best_score > alpha) alpha = best_score;
+        if (alpha >= beta) break;
+    }
+
+    return best_score;
+}
+
+/* One pass over the set. Returns the loss, and fills <grad> with the gradient of the loss by each weight if given. */
+static double _cortex_eval_tune_pass(cortex_eval_tune_set* set, const double* weights, int threads, double* grad) {
+    if (!set->count) return 0.0;
+
+    if (threads < 1) threads = 1;
+    if (threads > CORTEX_EVAL_MAX_THREADS) threads = CORTEX_EVAL_MAX_THREADS;
+
+    cortex_eval_tune_job jobs[CORTEX_EVAL_MAX_THREADS];
+
+    for (int i = 0; i < threads; ++i) {
+        jobs[i].set = set;
+        jobs[i].weights = weights;
+        jobs[i].gradient = grad != NULL;
+        _cortex_eval_tune_share(set->count, threads, i, &jobs[i].begin, &jobs[i].end);
+    }
+
+    _cortex_eval_tune_parallel(_cortex_eval_tune_main, jobs, sizeof *jobs, threads);
+
+    double loss = 0.0;
+
+    for (int i = 0; i < threads; ++i) {
+        loss += jobs[i].loss;
+    }
+
+    if (grad) {
+        /* d sigmoid(k e) / d e = s (1 - s) k ln(10) / 400, and the squared error doubles it. */
+        double scale = 2.0 * set->k * CORTEX_EVAL_TUNE_LN10 / 400.0 / set->count;
+
+        for (int w = 0; w < 2 * CORTEX_EVAL_WEIGHT_COUNT; ++w) {
+            grad[w] = 0.0;
+            for (int i = 0; i < threads; ++i) grad[w] += jobs[i].grad[w];
+            grad[w] *= scale;
+        }
+    }
+
+    return loss / set->count;
+}
+
+static void* _cortex_eval_tune_main(void* arg) {
+    cortex_eval_tune_job* job = arg;
+    const double* weights = job->weights;
+    double k = job->set->k * CORTEX_EVAL_TUNE_LN10 / 400.0;
+
+    job->loss = 0.0;
+    memset(job->grad, 0, sizeof job->grad);
+
+    for (size_t i = job->begin; i < job->end; ++i) {
+        const cortex_eval_tune_position* p = job->set->positions + i;
+
+        double mg = 0.0, eg = 0.0;
+
+        for (int w = 0; w < CORTEX_EVAL_WEIGHT_COUNT; ++w) {
+            mg += p->counts[w] * weights[2 * w];
+            eg += p->counts[w] * weights[2 * w + 1];
+        }
+
+        double mg_factor = (double) p->phase / CORTEX_EVAL_PHASE_MAX;
+        double eval = mg * mg_factor + eg * (1.0 - mg_factor);
+
+        double expected = 1.0 / (1.0 + exp(-k * eval));
+        double error = expected - p->result * 0.5;
+
+        job->loss += error * error;
+
+        if (!job->gradient) continue;
+
+        double d = error * expected * (1.0 - expected);
+
+        for (int w = 0; w < CORTEX_EVAL_WEIGHT_COUNT; ++w) {
+            job->grad[2 * w] += d * p->counts[w] * mg_factor;
+            job->grad[2 * w + 1] += d * p->counts[w] * (1.0 - mg_factor);
+        }
+    }
+
+    return NULL;
+}
+
+/* The current weights as doubles, midgame and endgame interleaved. */
+static void _cortex_eval_tune_get_weights(double* weights) {
+    for (int i = 0; i < CORTEX_EVAL_WEIGHT_COUNT; ++i) {
+        weights[2 * i] = CORTEX_EVAL_PAIR_MG(cortex_eval_weights[i]);
+        weights[2 * i + 1] = CORTEX_EVAL_PAIR_EG(cortex_eval_weights[i]);
+    }
+}
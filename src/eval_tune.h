@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * Texel tuning of the evaluation weights.
+ * Fits cortex_eval_weights to game results. Each labeled position is first resolved with a capture search,
+ * and the quiet position at the end of its best line stands in for it. The evaluation is linear in the
+ * weights, so a resolved position is kept as just its weight counts, phase and result, and an epoch of
+ * gradient descent on the sigmoid loss is one pass over a packed array, split across threads.
+ * Always tunes the handcrafted evaluation, never the network.
+ */
+
+#include "eval.h"
+
+/* Positions are read and resolved this many lines at a time. */
+#define CORTEX_EVAL_TUNE_CHUNK 65536
+
+typedef struct _cortex_eval_tune_position {
+    int8_t counts[CORTEX_EVAL_WEIGHT_COUNT]; /* see cortex_eval_features(), white-black */
+    u8 phase;
+    u8 result; /* half points scored by white */
+} cortex_eval_tune_position;
+
+typedef struct _cortex_eval_tune_set {
+    cortex_eval_tune_position* positions;
+    size_t count, capacity;
+    double k; /* sigmoid scale from centipawns to expected result, see cortex_eval_tune_fit() */
+} cortex_eval_tune_set;
+
+/* Called after each epoch with the loss over the set. */
+typedef void (*cortex_eval_tune_callback)(int epoch, double loss, void* data);
+
+/*
+ * Add the positions of a file to a set, resolving them on up to <threads> threads. One position per line:
+ * a FEN, then the result from white's side as 1-0, 0-1, 1/2-1/2 or a fraction in brackets ([1.0], [0.5], [0.0]).
+ * Lines that don't parse, positions in check, mated or stalemated positions and positions whose counts overflow are skipped.
+ * Returns the number of positions added, or -1 on error.
+ */
+long cortex_eval_tune_load(cortex_eval_tune_set* set, const char* path, int threads);
+void cortex_eval_tune_free(cortex_eval_tune_set* set);
+
+/* Mean squared error between the results and the expected results of the current weights. */
+double cortex_eval_tune_loss(cortex_eval_tune_set* set, int threads);
+
+/* Find the sigmoid scale that best fits the current weights, and store it in the set. Returns the loss. */
+double cortex_eval_tune_fit(cortex_eval_tune_set* set, int threads);
+
+/*
+ * Run <epochs> epochs of gradient descent (Adam) on the weights, moving each by about <rate> centipawns
+ * an epoch. Updates cortex_eval_weights. Returns -1 on error.
+ */
+int cortex_eval_tune_run(cortex_eval_tune_set* set, int epochs, double rate, int threads, cortex_eval_tune_callback cb, void* data);
+
+/* Write the current weights as a replacement for eval_weights.h. Returns -1 on error. */
+int cortex_eval_tune_write(const char* path);
@@ -0,0 +1,22 @@
+#pragma once
+
+/*
+ * Evaluation weights: name, midgame and endgame centipawns.
+ * Generated by cortex -tune. Rewritten in full by each tuning run.
+ */
+
+#define CORTEX_EVAL_WEIGHTS(W) \
+    W(PAWN, 100, 100) \
+    W(KNIGHT, 300, 300) \
+    W(BISHOP, 310, 310) \
+    W(ROOK, 500, 500) \
+    W(QUEEN, 650, 650) \
+    W(DEVELOPMENT, 150, 0) \
+    W(PAWN_ADVANCE, 0, 10) \
+    W(KING_CENTER, 0, 15) \
+    W(DOUBLED_PAWN, -10, -20) \
+    W(ISOLATED_PAWN, -10, -15) \
+    W(PASSED_PAWN, 5, 15) \
+    W(BISHOP_PAIR, 30, 50) \
+    W(MOBILITY, 2, 1) \
+    W(KING_ATTACK, 8, 0)
@@ -1,25 +1,191 @@
 #include "board.h"
+#include "clock.h"
 #include "eval.h"
+#include "eval_spsa.h"
+#include "eval_tune.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Print search progress as one line per report. */
+static void print_progress(const cortex_eval_info* info, void* data) {
+    printf("depth %d multipv %d score ", info->depth, info->multipv);
+
+    if (CORTEX_SCORE_IS_MATE(info->score)) {
+        printf("#%d", CORTEX_SCORE_MATE_IN(info->score));
+    } else {
+        printf("%.2f", info->score / 100.0f);
+    }
+
+    printf(" nodes %llu nps %llu time %llu hashfull %d pv", (unsigned long long) info->nodes, (unsigned long long) info->nps, (unsigned long long) info->time_ms, info->hashfull);
+
+    for (int i = 0; i < info->pv_len; ++i) {
+        printf(" ");
+        cortex_move_print_coord(info->pv[i]);
+    }
+
+    printf("\n");
+}
+
+/* Print the tuning loss after each epoch. */
+static void print_tune_progress(int epoch, double loss, void* data) {
+    printf("epoch %d loss %.8f\n", epoch, loss);
+}
+
+/* Tune the evaluation weights on a labeled position file and write them to <header>. */
+static int tune(const char* positions, const char* header, int epochs, int threads) {
+    cortex_eval_tune_set set = { 0 };
+
+    long count = cortex_eval_tune_load(&set, positions, threads);
+
+    if (count <= 0) {
+        fprintf(stderr, "No positions loaded from %s\n", positions);
+        return 1;
+    }
+
+    double loss = cortex_eval_tune_fit(&set, threads);
+    printf("%ld positions, k %.4f loss %.8f\n", count, set.k, loss);
+
+    cortex_eval_tune_run(&set, epochs, 1.0, threads, print_tune_progress, NULL);
+    cortex_eval_tune_free(&set);
+
+    if (cortex_eval_tune_write(header)) {
+        fprintf(stderr, "Failed to write %s\n", header);
+        return 1;
+    }
+
+    printf("Wrote %s\n", header);
+    return 0;
+}
+
+/* Print the SPSA progress after each round of games. */
+static void print_spsa_progress(int iterations, double score, void* data) {
+    printf("iterations %d score %.4f\n", iterations, score);
+}
+
+/* Take the time since <start_ms> off the clock and add the increment. The clock never runs out. */
+static void charge_clock(int* clock_ms, int inc_ms, uint64_t start_ms) {
+    if (!*clock_ms) return;
+
+    *clock_ms -= cortex_clock_ms() - start_ms;
+    if (*clock_ms < 1) *clock_ms = 1;
+
+    *clock_ms += inc_ms;
+    printf("Clock: %d ms\n", *clock_ms);
+}
 
 int main(int argc, char** argv) {
+    int clock_ms = 0, inc_ms = 0;
+    int threads = 1, epochs = 1000;
+    const char* tune_positions = NULL;
+    const char* tune_header = NULL;
+    const char* spsa_params = NULL;
+
+    cortex_eval_spsa_config spsa;
+    cortex_eval_spsa_defaults(&spsa);
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            cortex_eval_set_threads(threads);
+        } else if (!strcmp(argv[i], "-multipv") && i + 1 < argc) {
+            cortex_eval_set_multipv(atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "-clock") && i + 2 < argc) {
+            clock_ms = atoi(argv[++i]);
+            inc_ms = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-mtdf")) {
+            cortex_eval_set_driver(CORTEX_EVAL_DRIVER_MTDF);
+        } else if (!strcmp(argv[i], "-mcts")) {
+            cortex_eval_set_engine(CORTEX_EVAL_ENGINE_MCTS);
+        } else if (!strcmp(argv[i], "-ybwc")) {
+            cortex_eval_set_smp_mode(CORTEX_EVAL_SMP_YBWC);
+        } else if (!strcmp(argv[i], "-nnue") && i + 1 < argc) {
+            if (cortex_eval_nnue_load(argv[++i])) {
+                fprintf(stderr, "Failed to load network %s\n", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "-tune") && i + 2 < argc) {
+            tune_positions = argv[++i];
+            tune_header = argv[++i];
+        } else if (!strcmp(argv[i], "-epochs") && i + 1 < argc) {
+            epochs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-params") && i + 1 < argc) {
+            if (cortex_eval_spsa_load(argv[++i])) {
+                fprintf(stderr, "Failed to load parameters %s\n", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "-spsa") && i + 2 < argc) {
+            spsa.iterations = atoi(argv[++i]);
+            spsa_params = argv[++i];
+        } else if (!strcmp(argv[i], "-workers") && i + 1 < argc) {
+            spsa.workers = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-seed") && i + 1 < argc) {
+            spsa.seed = (unsigned) strtoul(argv[++i], NULL, 10);
+        }
+    }
+
+    if (tune_positions) return tune(tune_positions, tune_header, epochs, threads);
+
+    if (spsa_params) {
+        /* Self-play games use the same clock for both sides. */
+        spsa.clock_ms = clock_ms;
+        spsa.inc_ms = inc_ms;
+
+        if (cortex_eval_spsa_run(&spsa, print_spsa_progress, NULL) || cortex_eval_spsa_save(spsa_params)) {
+            fprintf(stderr, "SPSA tuning failed\n");
+            return 1;
+        }
+
+        printf("Wrote %s\n", spsa_params);
+        return 0;
+    }
+
     cortex_board b;
     cortex_board_init(&b);
 
+    /* Set while the search thread is pondering the position in <b>. */
+    int pondering = 0;
+
     while (1) {
         cortex_board_draw_types(&b);
 
         printf("Evaluating position..\n");
-        cortex_eval eval = cortex_eval_position(&b);
+
+        /* The engine plays on one clock for both colors, charged once per move. */
+        uint64_t start_ms = cortex_clock_ms();
+
+        cortex_move best_move;
+        cortex_score score;
+
+        if (pondering) {
+            /* The search has been running on the user's time. From here it is a normal search on the clock. */
+            cortex_eval_ponderhit();
+            score = cortex_eval_wait(&best_move);
+            pondering = 0;
+        } else {
+            cortex_eval_set_progress(print_progress, NULL, 1000);
+            cortex_eval_set_clock(clock_ms, inc_ms, 0);
+
+            if (cortex_eval_position(&b, &best_move, &score)) {
+                fprintf(stderr, "Failed to start the search\n");
+                return 1;
+            }
+        }
+
+        charge_clock(&clock_ms, inc_ms, start_ms);
+
         printf("Decided on best move ");
-        cortex_move_print_basic(eval.best_move);
+        cortex_move_print_basic(best_move);
         printf(" with current evaluation ");
 
-        if (eval.found_mate) {
-            printf("#%d\n", eval.mate_in);
+        /* Print from white's point of view. */
+        if (b.color_to_move != CORTEX_PIECE_COLOR_WHITE) score = -score;
+
+        if (CORTEX_SCORE_IS_MATE(score)) {
+            printf("#%d\n", CORTEX_SCORE_MATE_IN(score));
         } else {
-            printf("%f\n", eval.evaluation);
+            printf("%f\n", score / 100.0f);
         }
 
         const char* prompt = "black move: ";
@@ -27,9 +193,63 @@ int main(int argc, char** argv) {
             prompt = "white move: ";
         }
 
+        /*
+         * Keep searching on the user's time. If the best move is played, the next search is of the position after it,
+         * so that is the position pondered. Pondering is silent.
+         */
+        cortex_board next;
+        memcpy(&next, &b, sizeof next);
+
+        if (b.legal_moves.len && !cortex_board_apply_move(&next, best_move)) {
+            cortex_eval_set_progress(NULL, NULL, 0);
+            cortex_eval_set_clock(clock_ms, inc_ms, 0);
+            pondering = !cortex_eval_start(&next, 1);
+        }
+
         char mode = getchar();
 
-        if (mode == 'l') {
+        if (mode != '.' && pondering) {
+            cortex_eval_stop();
+            cortex_eval_wait(NULL);
+            pondering = 0;
+        }
+
+        if (mode == 'm') {
+            int moves = 0;
+            printf("mate in: ");
+
+            if (scanf("%d", &moves) == 1) {
+                cortex_move mate_move;
+                int found = cortex_eval_mate(&b, moves, &mate_move);
+
+                if (found > 0) {
+                    printf("Mate in %d starting with ", found);
+                    cortex_move_print_basic(mate_move);
+                } else {
+                    printf("No mate in %d\n", moves);
+                }
+            }
+        } else if (mode == 'p') {
+            cortex_move line[CORTEX_EVAL_MAX_PLY];
+            int line_len = 0;
+
+            int result = cortex_eval_pn(&b, 256 << 20, line, &line_len);
+
+            if (result == CORTEX_EVAL_PN_PROVEN) {
+                printf("Forced mate:");
+            } else if (result == CORTEX_EVAL_PN_DISPROVEN) {
+                printf("No forced mate:");
+            } else {
+                printf("Unknown:");
+            }
+
+            for (int i = 0; i < line_len; ++i) {
+                printf(" ");
+                cortex_move_print_coord(line[i]);
+            }
+
+            printf("\n");
+        } else if (mode == 'l') {
             printf("Legal moves:\n");
             cortex_move_list_print(&b.legal_moves);
         } else if (mode == '?') {
@@ -59,8 +279,8 @@ int main(int argc, char** argv) {
             cortex_board_apply_move(&b, move);
         } else if (mode == '.') {
             printf("applying best move: ");
-            cortex_move_print_basic(eval.best_move);
-            cortex_board_apply_move(&b, eval.best_move);
+            cortex_move_print_basic(best_move);
+            cortex_board_apply_move(&b, best_move);
         }
     }
 
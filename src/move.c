@@ -36,3 +36,21 @@ void cortex_move_print_basic(cortex_move m) {
 
    printf("\n");
 }
+
+void cortex_move_print_coord(cortex_move m) {
+    switch (m.move_type) {
+    case CORTEX_MOVE_TYPE_CASTLE_KING:
+        printf("O-O");
+        return;
+    case CORTEX_MOVE_TYPE_CASTLE_QUEEN:
+        printf("O-O-O");
+        return;
+    }
+
+    cortex_square_print(m.from);
+    cortex_square_print(m.to);
+
+    if (m.move_attr & CORTEX_MOVE_ATTR_PROMOTE) {
+        printf("%c", cortex_piece_type_char(m.promote_type));
+    }
+}
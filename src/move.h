@@ -44,3 +44,6 @@ typedef struct _cortex_move {
 } cortex_move;
 
 void cortex_move_print_basic(cortex_move m);
+
+/* Print a move in coordinate notation (e2e4, e7e8q) without a newline. */
+void cortex_move_print_coord(cortex_move m);
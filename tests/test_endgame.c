@@ -0,0 +1,102 @@
+#include "board.h"
+#include "eval.h"
+#include "eval_endgame.h"
+
+#include <stdio.h>
+
+#define SQ(file, rank) CORTEX_SQUARE_AT(rank, file)
+
+static int failures;
+
+/* Check one KPK bitbase entry against its known result. */
+static void check_kpk(const char* name, cortex_square wk, cortex_square wp, cortex_square bk, cortex_piece_color to_move, int win) {
+    int result = cortex_eval_endgame_kpk(wk, wp, bk, to_move);
+    if (result == win) return;
+
+    printf("FAIL kpk %s: got %d, expected %d\n", name, result, win);
+    ++failures;
+}
+
+/* Probe a position and return its recognized score, white-black. */
+static cortex_score probe(const char* fen, int expect) {
+    cortex_board b;
+    cortex_score score = 0;
+
+    cortex_board_init(&b);
+    cortex_board_set_fen(&b, fen);
+
+    int result = cortex_eval_endgame_probe(&b, &score);
+
+    if (result != expect) {
+        printf("FAIL probe %s: got result %d, expected %d\n", fen, result, expect);
+        ++failures;
+    }
+
+    return score;
+}
+
+/* The defending king must score worse for it in the bishop's corner than in the other one. */
+static void check_kbnk_corner(const char* right, const char* wrong) {
+    cortex_score right_score = probe(right, CORTEX_EVAL_ENDGAME_WIN);
+    cortex_score wrong_score = probe(wrong, CORTEX_EVAL_ENDGAME_WIN);
+
+    if (right_score > wrong_score) return;
+
+    printf("FAIL kbnk corner: %s scores %d, %s scores %d\n", right, right_score, wrong, wrong_score);
+    ++failures;
+}
+
+/* Play KBNK out against itself. The evaluation has to lead the search to a mate before the fifty-move rule. */
+static void check_kbnk_mate(const char* fen) {
+    cortex_board b;
+
+    cortex_board_init(&b);
+    cortex_board_set_fen(&b, fen);
+
+    int ply;
+
+    for (ply = 0; ply < 100 && b.legal_moves.len && !cortex_board_is_draw(&b, 2); ++ply) {
+        cortex_move move;
+
+        if (cortex_eval_position(&b, &move, NULL) || cortex_board_apply_move(&b, move)) break;
+    }
+
+    if (!b.legal_moves.len && cortex_eval_in_check(&b)) return;
+
+    printf("FAIL kbnk mate %s: no mate after %d plies\n", fen, ply);
+    ++failures;
+}
+
+int main(int argc, char** argv) {
+    check_kpk("Ke1 Pe2 Ke8, white to move", SQ(5, 1), SQ(5, 2), SQ(5, 8), CORTEX_PIECE_COLOR_WHITE, 1);
+    check_kpk("Ke5 Pe4 Ke7, white to move", SQ(5, 5), SQ(5, 4), SQ(5, 7), CORTEX_PIECE_COLOR_WHITE, 0);
+    check_kpk("Ke5 Pe4 Ke7, black to move", SQ(5, 5), SQ(5, 4), SQ(5, 7), CORTEX_PIECE_COLOR_BLACK, 1);
+    check_kpk("Ke4 Pe3 Ke6, white to move", SQ(5, 4), SQ(5, 3), SQ(5, 6), CORTEX_PIECE_COLOR_WHITE, 0);
+    check_kpk("Ke4 Pe3 Ke6, black to move", SQ(5, 4), SQ(5, 3), SQ(5, 6), CORTEX_PIECE_COLOR_BLACK, 1);
+    check_kpk("Kh6 Ph5 Kh8, white to move", SQ(8, 6), SQ(8, 5), SQ(8, 8), CORTEX_PIECE_COLOR_WHITE, 0);
+    check_kpk("Ka1 Pa7 Kh1, white to move", SQ(1, 1), SQ(1, 7), SQ(8, 1), CORTEX_PIECE_COLOR_WHITE, 1);
+    check_kpk("Ka1 Pa4 Ke4, black to move", SQ(1, 1), SQ(1, 4), SQ(5, 4), CORTEX_PIECE_COLOR_BLACK, 0);
+    check_kpk("Ka1 Pa4 Kg4, black to move", SQ(1, 1), SQ(1, 4), SQ(7, 4), CORTEX_PIECE_COLOR_BLACK, 1);
+
+    /* A black pawn is looked up with the board flipped. The second position is Ke4 Pe3 Ke6 mirrored. */
+    if (probe("8/8/8/8/8/8/p6K/4k3 w - - 0 1", CORTEX_EVAL_ENDGAME_WIN) >= 0) {
+        printf("FAIL kpk black pawn: not scored as a win for black\n");
+        ++failures;
+    }
+
+    probe("8/8/4p3/4k3/8/4K3/8/8 b - - 0 1", CORTEX_EVAL_ENDGAME_DRAW);
+
+    /* A dark bishop mates on a1 or h8, a light one on a8 or h1. */
+    check_kbnk_corner("8/8/4N3/2BK4/8/8/8/k7 b - - 0 1", "8/8/4N3/2BK4/8/8/8/7k b - - 0 1");
+    check_kbnk_corner("8/8/4N3/1B1K4/8/8/8/7k b - - 0 1", "8/8/4N3/1B1K4/8/8/8/k7 b - - 0 1");
+
+    check_kbnk_mate("8/8/8/4k3/8/8/8/1K2N2B w - - 0 1");
+
+    if (failures) {
+        printf("%d endgame checks failed\n", failures);
+        return 1;
+    }
+
+    printf("endgame checks passed\n");
+    return 0;
+}